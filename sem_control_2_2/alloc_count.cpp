@@ -0,0 +1,26 @@
+#include <cstdlib>
+#include <new>
+
+#include "alloc_count.h"
+
+// Replaces the global operator new to count every heap allocation, see instrumentation::allocation_count().
+// Linked into the test and benchmark executables only.
+// Out of line, so the compiler doesn't pair inlined malloc/free calls with new/delete expressions.
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    ++instrumentation::allocations;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
@@ -0,0 +1,15 @@
+#pragma once 
+#include <atomic>
+#include <cstddef>
+
+namespace instrumentation
+{
+	// Heap allocations made through operator new. Executables linking alloc_count.cpp replace the
+	// global operator new to bump it; without it the count stays at 0.
+	inline std::atomic<size_t> allocations{ 0 };
+
+	inline size_t allocation_count()
+	{
+		return allocations.load(std::memory_order_relaxed);
+	}
+} // instrumentation
@@ -0,0 +1,125 @@
+#pragma once 
+#include <string>
+#include <string_view>
+#include <map>
+#include <memory_resource>
+#include <new>
+
+#include "dict.h"
+
+namespace serialization
+{
+	// dict whose nodes, keys and values all come from a memory resource (dict_arena below),
+	// so building a tree costs no per-node heap allocation
+	struct arena_dict
+	{
+		// compares keys as string_views, so names are looked up without a copy
+		struct key_less
+		{
+			typedef void is_transparent;
+
+			bool operator()(std::string_view a, std::string_view b) const
+			{
+				return a < b;
+			}
+		};
+
+		typedef std::pmr::polymorphic_allocator<char> allocator_type;
+
+		explicit arena_dict(allocator_type const& allocator)
+			: value(allocator)
+			, children(allocator)
+		{
+		}
+
+		arena_dict(arena_dict const& other, allocator_type const& allocator)
+			: value(other.value, allocator)
+			, children(other.children, allocator)
+		{
+		}
+
+		arena_dict(arena_dict&& other, allocator_type const& allocator)
+			: value(std::move(other.value), allocator)
+			, children(std::move(other.children), allocator)
+		{
+		}
+
+		std::pmr::string									value;
+		std::pmr::map<std::pmr::string, arena_dict, key_less>	children;
+	};
+
+	// Monotonic arena for arena_dict trees. Nodes are carved out of a few large buffers and never
+	// freed one by one: release() drops every tree created in the arena at once, without visiting
+	// them, in time proportional to the number of buffers.
+	class dict_arena
+	{
+	public:
+		explicit dict_arena(size_t initial_size = 64 * 1024)
+			: resource_(initial_size)
+		{
+		}
+
+		dict_arena(dict_arena const&) = delete;
+		dict_arena& operator=(dict_arena const&) = delete;
+
+		// empty root node, valid until release()
+		arena_dict& create()
+		{
+			void* p = resource_.allocate(sizeof(arena_dict), alignof(arena_dict));
+			// never destroyed: everything its destructor would free belongs to the arena anyway
+			return *new (p) arena_dict(arena_dict::allocator_type(&resource_));
+		}
+
+		void release()
+		{
+			resource_.release();
+		}
+
+	private:
+		std::pmr::monotonic_buffer_resource resource_;
+	};
+
+	template<>
+	struct is_dict_node<arena_dict> : std::true_type
+	{
+	};
+
+	inline std::pmr::string const& dict_value(arena_dict const& d)
+	{
+		return d.value;
+	}
+
+	inline void set_dict_value(arena_dict& d, const char* data, size_t size)
+	{
+		d.value.assign(data, size);
+	}
+
+	inline arena_dict const* find_child(arena_dict const& d, std::string_view name)
+	{
+		auto it = d.children.find(name);
+		return it != d.children.end() ? &it->second : nullptr;
+	}
+
+	inline arena_dict& add_child(arena_dict& d, std::string_view name)
+	{
+		auto it = d.children.lower_bound(name);
+		if (it == d.children.end() || it->first != name)
+		{
+			// the key and the node are constructed with the map's allocator
+			it = d.children.emplace_hint(it, std::piecewise_construct,
+			                             std::forward_as_tuple(name.data(), name.size()), std::forward_as_tuple());
+		}
+		return it->second;
+	}
+
+	inline void close_children(arena_dict&)
+	{
+	}
+
+	template<class F>
+	void for_each_child(arena_dict const& d, F&& f)
+	{
+		for (auto const& child : d.children)
+			f(std::string_view(child.first), child.second);
+	}
+} // serialization
@@ -0,0 +1,24 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+QMAKE_CXX = clang++
+QMAKE_CC = clang
+
+CONFIG += c++17
+CONFIG += thread
+
+TARGET = sem_control_2_2_bench
+
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    ../alloc_count.cpp
+
+include(../deployment.pri)
+qtcAddDeployment()
+
+HEADERS += \
+    micro.h \
+    suite.h
@@ -0,0 +1,49 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "micro.h"
+#include "suite.h"
+
+// sem_control_2_2_bench                      throughput suite, CSV on stdout
+// sem_control_2_2_bench --max-bytes N        suite with batches up to N bytes, N >= 16
+// sem_control_2_2_bench --micro              micro benchmarks of individual optimizations
+
+// the smallest batch is 16 bytes, the suite needs room for at least that one
+static bool parse_max_bytes(const char* text, size_t& max_payload)
+{
+    char* end;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || text[0] == '-' || value < 16)
+        return false;
+
+    max_payload = value;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t max_payload = 64 << 20;
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        if (strcmp(argv[arg], "--micro") == 0)
+        {
+            bench::run_all();
+            return 0;
+        }
+        else if (strcmp(argv[arg], "--max-bytes") == 0 && arg + 1 < argc && parse_max_bytes(argv[arg + 1], max_payload))
+            ++arg;
+        else
+        {
+            fprintf(stderr, "usage: %s [--max-bytes N | --micro]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    suite::run_all(max_payload, std::min<size_t>(max_payload, 4 << 20));
+    return 0;
+}
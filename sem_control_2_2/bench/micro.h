@@ -0,0 +1,978 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+#include <string>
+#include <sstream>
+#include <stdexcept>
+
+#include "alloc_count.h"
+#include "arena_dict.h"
+#include "buffer_pool.h"
+#include "checksummed_blocks.h"
+#include "columns.h"
+#include "dict_json.h"
+#include "compressed_blocks.h"
+#include "delta.h"
+#include "io_streams.h"
+#include "parallel.h"
+#include "flat_dict.h"
+#include "framed.h"
+#include "record_view.h"
+#include "task.h"
+
+// Micro benchmarks of individual optimizations, run with `sem_control_2_2_bench --micro`
+
+namespace bench
+{
+
+// best of a few runs, to smooth out noise
+template <class F>
+double measure_seconds(F&& f, int runs = 3)
+{
+    double best = 0;
+    for (int run = 0; run < runs; ++run)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (run == 0 || elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best;
+}
+
+inline void report(const char* name, double bytes, double seconds)
+{
+    printf("%-40s %10.1f MB/s\n", name, bytes / seconds / (1024 * 1024));
+}
+
+// output_stream as it was before the explicit growth policy: resize() per write,
+// zero-filling the tail before memcpy overwrites it
+struct resizing_output_stream
+{
+    void write(const void* data, size_t size)
+    {
+        size_t old_size = buffer_.size();
+        buffer_.resize(old_size + size);
+        memcpy(buffer_.data() + old_size, data, size);
+    }
+
+    std::vector<char> buffer_;
+};
+
+template <class stream_t>
+size_t fill_stream(stream_t& os, size_t records)
+{
+    int    i = 42;
+    double d = 3.14;
+    char   c = 'P';
+    for (size_t n = 0; n < records; ++n)
+    {
+        os.write(&i, sizeof(i));
+        os.write(&d, sizeof(d));
+        os.write(&c, sizeof(c));
+    }
+    return records * (sizeof(i) + sizeof(d) + sizeof(c));
+}
+
+inline void bench_output_stream()
+{
+    const size_t records = 10 * 1000 * 1000;
+    size_t bytes = 0;
+
+    double before = measure_seconds([&]
+    {
+        resizing_output_stream os;
+        bytes = fill_stream(os, records);
+    });
+    report("output_stream write (resize per field)", bytes, before);
+
+    double after = measure_seconds([&]
+    {
+        serialization::output_stream os;
+        bytes = fill_stream(os, records);
+    });
+    report("output_stream write (geometric growth)", bytes, after);
+
+    double reserved = measure_seconds([&]
+    {
+        serialization::output_stream os;
+        os.reserve(records * 13);
+        bytes = fill_stream(os, records);
+    });
+    report("output_stream write (reserved)", bytes, reserved);
+}
+
+struct bench_record
+{
+    int    a;
+    double b;
+    char   c;
+    int    d;
+
+    bench_record() : a(0), b(0), c(0), d(0) {}
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, bench_record& r)
+{
+    visitor(r.a, "a");
+    visitor(r.b, "b");
+    visitor(r.c, "c");
+    visitor(r.d, "d");
+}
+
+inline serialization::bytes_t make_records(size_t records)
+{
+    bench_record r;
+    r.a = 1, r.b = 2.5, r.c = 'c', r.d = 4;
+
+    serialization::output_stream os;
+    for (size_t n = 0; n < records; ++n)
+        serialization::write(os, r);
+    return os.detach();
+}
+
+inline void bench_checked_read()
+{
+    const size_t records = 10 * 1000 * 1000;
+    serialization::bytes_t bytes = make_records(records);
+    long long sum = 0;
+
+    double unchecked = measure_seconds([&]
+    {
+        serialization::input_stream is(bytes);
+        bench_record r;
+        for (size_t n = 0; n < records; ++n)
+        {
+            serialization::read(is, r);
+            sum += r.a;
+        }
+    });
+    report("input_stream read (unchecked)", bytes.size(), unchecked);
+
+    double checked = measure_seconds([&]
+    {
+        serialization::input_stream is(bytes);
+        bench_record r;
+        std::error_code ec;
+        for (size_t n = 0; n < records && !ec; ++n)
+        {
+            serialization::read(is, r, ec);
+            sum += r.a;
+        }
+    });
+    report("input_stream read (checked)", bytes.size(), checked);
+    printf("%-40s %+10.1f %%\n", "checked read overhead", (checked / unchecked - 1) * 100);
+
+    if (sum != 2 * 3 * (long long)records)
+        printf("unexpected checksum %lld\n", sum);
+}
+
+inline void bench_vector()
+{
+    std::vector<float> column(16 * 1024 * 1024, 1.5f);
+    double bytes = column.size() * sizeof(float);
+
+    double per_element = measure_seconds([&]
+    {
+        serialization::output_stream os;
+        serialization::write(os, static_cast<serialization::size_type>(column.size()));
+        for (float value : column)
+            serialization::write(os, value);
+    });
+    report("vector<float> write (per element)", bytes, per_element);
+
+    serialization::bytes_t encoded;
+    double bulk = measure_seconds([&]
+    {
+        serialization::output_stream os;
+        serialization::write(os, column);
+        encoded = os.detach();
+    });
+    report("vector<float> write (bulk)", bytes, bulk);
+
+    double bulk_read = measure_seconds([&]
+    {
+        serialization::input_stream is(encoded);
+        std::vector<float> read_column;
+        serialization::read(is, read_column);
+    });
+    report("vector<float> read (bulk)", bytes, bulk_read);
+}
+
+inline void bench_varint()
+{
+    // mostly small values, with an occasional large one
+    std::vector<int64_t> column(16 * 1024 * 1024);
+    for (size_t i = 0; i < column.size(); ++i)
+        column[i] = i % 97 == 0 ? static_cast<int64_t>(i) * 1000 : static_cast<int64_t>(i % 50) - 25;
+    double bytes = column.size() * sizeof(int64_t);
+
+    serialization::bytes_t fixed_encoded;
+    report("vector<int64_t> write (fixed width)", bytes, measure_seconds([&]
+    {
+        serialization::output_stream os;
+        serialization::write(os, column);
+        fixed_encoded = os.detach();
+    }));
+
+    serialization::bytes_t compact_encoded;
+    report("vector<int64_t> write (varint)", bytes, measure_seconds([&]
+    {
+        serialization::compact_output_stream os;
+        serialization::write(os, column);
+        compact_encoded = os.detach();
+    }));
+
+    std::vector<int64_t> decoded;
+    report("vector<int64_t> read (fixed width)", bytes, measure_seconds([&]
+    {
+        serialization::input_stream is(fixed_encoded);
+        serialization::read(is, decoded);
+    }));
+
+    report("vector<int64_t> read (varint, bulk)", bytes, measure_seconds([&]
+    {
+        serialization::compact_input_stream is(compact_encoded);
+        serialization::read(is, decoded);
+    }));
+
+    report("vector<int64_t> read (varint, one by one)", bytes, measure_seconds([&]
+    {
+        serialization::compact_input_stream is(compact_encoded);
+        serialization::size_type size;
+        serialization::read(is, size);
+        decoded.resize(size);
+        for (int64_t& value : decoded)
+            serialization::read(is, value);
+    }));
+
+    printf("%-40s %10.2f x\n", "varint size reduction", double(fixed_encoded.size()) / compact_encoded.size());
+}
+
+inline void report_rate(const char* name, double items, const char* unit, double seconds)
+{
+    printf("%-40s %10.2f M%s/s\n", name, items / seconds / 1e6, unit);
+}
+
+inline void report_allocations(const char* name, size_t allocations, size_t records)
+{
+    printf("%-40s %10.2f allocs/record\n", name, double(allocations) / records);
+}
+
+// config tree with `records` bench_records under the root, 5 nodes each
+template <class root_t>
+void build_tree(root_t root, size_t records, std::vector<std::string> const& keys)
+{
+    bench_record r;
+    r.a = 1, r.b = 2.5, r.c = 'c', r.d = 4;
+
+    for (size_t n = 0; n < records; ++n)
+        serialization::write(serialization::add_child(root, keys[n]), r);
+    serialization::close_children(root);
+}
+
+template <class root_t>
+long long read_tree(root_t root, size_t records, std::vector<std::string> const& keys)
+{
+    long long sum = 0;
+    bench_record r;
+    for (size_t n = 0; n < records; ++n)
+    {
+        serialization::read(*serialization::find_child(root, keys[n]), r);
+        sum += r.a;
+    }
+    return sum;
+}
+
+inline void bench_dict_backends()
+{
+    const size_t records = 20 * 1000;
+    const double nodes = records * 5;
+
+    std::vector<std::string> keys;
+    for (size_t n = 0; n < records; ++n)
+        keys.push_back("record" + std::to_string(n));
+
+    serialization::dict map_dict;
+    report_rate("dict build (std::map)", nodes, "nodes", measure_seconds([&]
+    {
+        map_dict = serialization::dict();
+        build_tree<serialization::dict&>(map_dict, records, keys);
+    }));
+
+    serialization::flat_dict flat;
+    report_rate("dict build (flat)", nodes, "nodes", measure_seconds([&]
+    {
+        flat = serialization::flat_dict();
+        build_tree(flat.root(), records, keys);
+    }));
+
+    serialization::dict_arena arena;
+    serialization::arena_dict* arena_root = nullptr;
+    report_rate("dict build (arena)", nodes, "nodes", measure_seconds([&]
+    {
+        arena.release();
+        arena_root = &arena.create();
+        build_tree<serialization::arena_dict&>(*arena_root, records, keys);
+    }));
+
+    long long sum = 0;
+    report_rate("dict read (std::map)", nodes, "nodes", measure_seconds([&]
+    {
+        sum += read_tree<serialization::dict const&>(map_dict, records, keys);
+    }));
+
+    report_rate("dict read (flat)", nodes, "nodes", measure_seconds([&]
+    {
+        sum += read_tree(static_cast<serialization::flat_dict const&>(flat).root(), records, keys);
+    }));
+
+    report_rate("dict read (arena)", nodes, "nodes", measure_seconds([&]
+    {
+        sum += read_tree<serialization::arena_dict const&>(*arena_root, records, keys);
+    }));
+
+    if (sum != 9 * (long long)records)
+        printf("unexpected checksum %lld\n", sum);
+
+    size_t before = instrumentation::allocation_count();
+    {
+        serialization::dict d;
+        build_tree<serialization::dict&>(d, records, keys);
+    }
+    report_allocations("dict build (std::map)", instrumentation::allocation_count() - before, records);
+
+    before = instrumentation::allocation_count();
+    {
+        serialization::flat_dict d;
+        build_tree(d.root(), records, keys);
+    }
+    report_allocations("dict build (flat)", instrumentation::allocation_count() - before, records);
+
+    before = instrumentation::allocation_count();
+    {
+        serialization::dict_arena allocations_arena;
+        build_tree<serialization::arena_dict&>(allocations_arena.create(), records, keys);
+    }
+    report_allocations("dict build (arena)", instrumentation::allocation_count() - before, records);
+}
+
+// scalar conversion as it was done before to_chars/from_chars
+template <class T>
+void stringstream_write(serialization::dict& d, T data)
+{
+    std::stringstream stream;
+    stream << data;
+    stream >> d.value;
+}
+
+template <class T>
+void stringstream_read(serialization::dict const& d, T& data)
+{
+    std::stringstream stream;
+    stream << d.value;
+    stream >> data;
+}
+
+inline void bench_dict_scalars()
+{
+    const size_t scalars = 1000 * 1000;
+
+    std::vector<serialization::dict> leaves(scalars);
+    double sum = 0;
+
+    report_rate("dict scalar write (stringstream)", scalars, "scalars", measure_seconds([&]
+    {
+        for (size_t n = 0; n < scalars; ++n)
+            stringstream_write(leaves[n], n * 0.25);
+    }));
+
+    report_rate("dict scalar read (stringstream)", scalars, "scalars", measure_seconds([&]
+    {
+        double value;
+        for (size_t n = 0; n < scalars; ++n)
+        {
+            stringstream_read(leaves[n], value);
+            sum += value;
+        }
+    }));
+
+    report_rate("dict scalar write (to_chars)", scalars, "scalars", measure_seconds([&]
+    {
+        for (size_t n = 0; n < scalars; ++n)
+            serialization::write(leaves[n], n * 0.25);
+    }));
+
+    report_rate("dict scalar read (from_chars)", scalars, "scalars", measure_seconds([&]
+    {
+        double value;
+        for (size_t n = 0; n < scalars; ++n)
+        {
+            serialization::read(leaves[n], value);
+            sum += value;
+        }
+    }));
+
+    if (sum == 0)
+        printf("unexpected checksum\n");
+}
+
+// old version of bench_record, before b, c and d were added
+struct bench_record_v0
+{
+    int a;
+
+    bench_record_v0() : a(1) {}
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, bench_record_v0& r)
+{
+    visitor(r.a, "a");
+}
+
+// missing field handling as it was done before find_child: catching std::out_of_range
+template <class T>
+void throwing_read(serialization::dict const& d, T& data)
+{
+    reflect([&d](auto& field, serialization::field_name name)
+    {
+        try
+        {
+            serialization::read(d.children.at(name.str()), field);
+        }
+        catch(const std::out_of_range&)
+        {
+            field = typename std::remove_reference<decltype(field)>::type();
+        }
+    }, data);
+}
+
+inline void bench_dict_versioning()
+{
+    const size_t records = 100 * 1000;
+
+    serialization::dict old_record;
+    serialization::write(old_record, bench_record_v0());
+
+    long long sum = 0;
+    report_rate("dict read, 3 of 4 fields missing (throw)", records, "records", measure_seconds([&]
+    {
+        bench_record r;
+        for (size_t n = 0; n < records; ++n)
+        {
+            throwing_read(old_record, r);
+            sum += r.a;
+        }
+    }));
+
+    report_rate("dict read, 3 of 4 fields missing (find)", records, "records", measure_seconds([&]
+    {
+        bench_record r;
+        for (size_t n = 0; n < records; ++n)
+        {
+            serialization::read(old_record, r);
+            sum += r.a;
+        }
+    }));
+
+    if (sum != 6 * (long long)records)
+        printf("unexpected checksum %lld\n", sum);
+}
+
+struct bench_nested
+{
+    bench_record inner;
+    double       x;
+    bench_record outer;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, bench_nested& r)
+{
+    visitor(r.inner, "inner");
+    visitor(r.x, "x");
+    visitor(r.outer, "outer");
+}
+
+// the per-field reflect() walk compiled schemas replace
+template <class T>
+typename std::enable_if<std::is_arithmetic<T>::value, void>::type
+walk_write(serialization::output_stream& os, const T& data)
+{
+    serialization::write(os, data);
+}
+
+template <class T>
+typename std::enable_if<!std::is_arithmetic<T>::value, void>::type
+walk_write(serialization::output_stream& os, const T& data)
+{
+    reflect([&os](auto& field, serialization::field_name){ walk_write(os, field); }, const_cast<T&>(data));
+}
+
+inline void bench_dict_json()
+{
+    const size_t records = 100 * 1000;
+
+    std::vector<std::string> keys;
+    for (size_t n = 0; n < records; ++n)
+        keys.push_back("record" + std::to_string(n));
+
+    serialization::dict tree;
+    build_tree<serialization::dict&>(tree, records, keys);
+
+    std::string text;
+    double write_seconds = measure_seconds([&]
+    {
+        text.clear();
+        serialization::write_json(text, tree);
+    });
+    report("json write (dict)", text.size(), write_seconds);
+
+    report("json parse (dict)", text.size(), measure_seconds([&]
+    {
+        serialization::dict parsed;
+        serialization::from_json(text, parsed);
+    }));
+
+    report("json parse (flat)", text.size(), measure_seconds([&]
+    {
+        serialization::flat_dict parsed;
+        serialization::from_json(text, parsed.root());
+    }));
+
+    serialization::dict_arena arena;
+    report("json parse (arena)", text.size(), measure_seconds([&]
+    {
+        arena.release();
+        serialization::from_json(text, arena.create());
+    }));
+
+    size_t before = instrumentation::allocation_count();
+    arena.release();
+    serialization::from_json(text, arena.create());
+    report_allocations("json parse (arena)", instrumentation::allocation_count() - before, records);
+}
+
+inline void bench_compiled_schema()
+{
+    const size_t records = 5 * 1000 * 1000;
+    bench_nested r;
+    r.x = 1;
+    double bytes = records * serialization::serialized_size<bench_nested>();
+
+    report("nested record write (reflect walk)", bytes, measure_seconds([&]
+    {
+        serialization::output_stream os;
+        for (size_t n = 0; n < records; ++n)
+            walk_write(os, r);
+    }));
+
+    report("nested record write (compiled schema)", bytes, measure_seconds([&]
+    {
+        serialization::output_stream os;
+        for (size_t n = 0; n < records; ++n)
+            serialization::write(os, r);
+    }));
+}
+
+inline void bench_columns()
+{
+    const size_t records = 2 * 1000 * 1000;
+    std::vector<bench_record> batch(records);
+    for (size_t n = 0; n < records; ++n)
+        batch[n].a = static_cast<int>(n);
+    double count = records;
+
+    serialization::bytes_t rows, columns;
+    report_rate("batch write (rows)", count, "records", measure_seconds([&]
+    {
+        serialization::output_stream os;
+        serialization::write(os, batch);
+        rows = os.detach();
+    }));
+
+    report_rate("batch write (columns)", count, "records", measure_seconds([&]
+    {
+        serialization::output_stream os;
+        serialization::write_columns(os, batch);
+        columns = os.detach();
+    }));
+
+    std::vector<bench_record> read_batch;
+    report_rate("batch read all fields (rows)", count, "records", measure_seconds([&]
+    {
+        serialization::input_stream is(rows);
+        serialization::read(is, read_batch);
+    }));
+
+    report_rate("batch read all fields (columns)", count, "records", measure_seconds([&]
+    {
+        serialization::input_stream is(columns);
+        serialization::read_columns(is, read_batch);
+    }));
+
+    std::vector<int> a;
+    report_rate("batch read one field (column)", count, "records", measure_seconds([&]
+    {
+        serialization::input_stream is(columns);
+        serialization::read_column(is, "a", a);
+    }));
+}
+
+// same shape as custom_record in main.cpp
+struct bench_small
+{
+    char letter = 0;
+    bool flag = false;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, bench_small& r)
+{
+    visitor(r.letter, "letter");
+    visitor(r.flag, "flag");
+}
+
+struct bench_custom
+{
+    double      dvalue = 0;
+    int         ivalue = 0;
+    bench_small small;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, bench_custom& r)
+{
+    visitor(r.dvalue, "dvalue");
+    visitor(r.ivalue, "ivalue");
+    visitor(r.small, "small");
+}
+
+struct bench_event
+{
+    int32_t             kind = 0;
+    std::string         source;
+    std::vector<float>  samples;
+    int32_t             priority = 0;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, bench_event& r)
+{
+    visitor(r.kind, "kind");
+    visitor(r.source, "source");
+    visitor(r.samples, "samples");
+    visitor(r.priority, "priority");
+}
+
+// filter stage keeping 1 record in 20, by a field before and after the variable-size ones
+inline void bench_record_view()
+{
+    const size_t records = 1000 * 1000;
+
+    serialization::output_stream os;
+    serialization::framed_writer writer(os);
+    bench_event e;
+    for (size_t n = 0; n < records; ++n)
+    {
+        e.kind = static_cast<int32_t>(n % 20);
+        e.source = "sensor " + std::to_string(n % 1000);
+        e.samples.assign(16, n * 0.5f);
+        e.priority = static_cast<int32_t>(n % 20);
+        writer.append(e);
+    }
+    writer.finish();
+    serialization::framed_reader reader(os.data());
+
+    size_t kept = 0;
+    report_rate("filter by first field (full read)", records, "records", measure_seconds([&]
+    {
+        bench_event event;
+        for (size_t k = 0; k < records; ++k)
+        {
+            reader.read_record(k, event);
+            kept += event.kind == 0;
+        }
+    }));
+
+    report_rate("filter by first field (view)", records, "records", measure_seconds([&]
+    {
+        for (size_t k = 0; k < records; ++k)
+        {
+            serialization::record_view<bench_event> view(reader.record(k));
+            kept += view.get(&bench_event::kind) == 0;
+        }
+    }));
+
+    report_rate("filter by last field (view)", records, "records", measure_seconds([&]
+    {
+        for (size_t k = 0; k < records; ++k)
+        {
+            serialization::record_view<bench_event> view(reader.record(k));
+            kept += view.get(&bench_event::priority) == 0;
+        }
+    }));
+
+    if (kept != 9 * records / 20)
+        printf("unexpected count %zu\n", kept);
+}
+
+inline void bench_parallel()
+{
+    const size_t records = 4 * 1000 * 1000;
+    std::vector<bench_custom> batch(records);
+    for (size_t n = 0; n < records; ++n)
+        batch[n].ivalue = static_cast<int>(n);
+
+    for (size_t threads : { 1, 2, 4, 8, 16 })
+    {
+        char name[64];
+        serialization::bytes_t encoded;
+
+        snprintf(name, sizeof(name), "parallel write, %zu threads", threads);
+        report_rate(name, records, "records", measure_seconds([&]
+        {
+            serialization::output_stream os;
+            serialization::write_parallel(os, batch, threads);
+            encoded = os.detach();
+        }));
+
+        snprintf(name, sizeof(name), "parallel read, %zu threads", threads);
+        std::vector<bench_custom> read_batch;
+        report_rate(name, records, "records", measure_seconds([&]
+        {
+            serialization::input_stream is(encoded);
+            serialization::read_parallel(is, read_batch, threads);
+        }));
+    }
+}
+
+inline void bench_compression()
+{
+    const size_t records = 4 * 1000 * 1000;
+    std::vector<bench_custom> batch(records);
+    for (size_t n = 0; n < records; ++n)
+    {
+        batch[n].dvalue = n % 100 * 0.25;
+        batch[n].ivalue = static_cast<int>(n);
+        batch[n].small.letter = static_cast<char>('a' + n % 26);
+    }
+
+    serialization::output_stream plain;
+    for (bench_custom const& r : batch)
+        serialization::write(plain, r);
+    serialization::bytes_t raw = plain.detach();
+
+    serialization::bytes_t compressed;
+    double compress = measure_seconds([&]
+    {
+        compressed.clear();
+        serialization::output_stream os(serialization::compressing_sink([&compressed](const char* data, size_t size)
+        {
+            compressed.insert(compressed.end(), data, data + size);
+        }));
+        for (bench_custom const& r : batch)
+            serialization::write(os, r);
+        os.flush();
+    });
+    report("compressed write (64 KiB blocks)", raw.size(), compress);
+
+    serialization::bytes_t decompressed;
+    double decompress = measure_seconds([&]
+    {
+        serialization::decompress_blocks(compressed.data(), compressed.size(), decompressed);
+    });
+    report("decompress blocks", raw.size(), decompress);
+
+    printf("%-40s %10.2f x\n", "compression ratio", double(raw.size()) / compressed.size());
+}
+
+inline void bench_checksum()
+{
+    serialization::bytes_t data(64 << 20);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<char>(i * 2654435761u >> 13);
+
+    uint32_t crc = 0, table_crc = 0;
+    report("crc32c", data.size(), measure_seconds([&]
+    {
+        crc = serialization::crc32c(data.data(), data.size());
+    }));
+    report("crc32c (tables)", data.size(), measure_seconds([&]
+    {
+        table_crc = ~serialization::details::crc32c_table(~0u, reinterpret_cast<const unsigned char*>(data.data()), data.size());
+    }));
+    if (crc != table_crc)
+        printf("crc32c implementations disagree\n");
+
+    // encoding into a streaming output_stream, with and without checksummed blocks
+    const size_t records = 4 * 1000 * 1000;
+    std::vector<bench_custom> batch(records);
+    for (size_t n = 0; n < records; ++n)
+        batch[n].ivalue = static_cast<int>(n);
+
+    size_t payload = 0;
+    for (bench_custom const& r : batch)
+        payload += serialization::measure(r);
+
+    serialization::sink_t discard = [](const char*, size_t){};
+    auto encode = [&](serialization::sink_t const& sink)
+    {
+        return measure_seconds([&]
+        {
+            serialization::output_stream os(sink);
+            for (bench_custom const& r : batch)
+                serialization::write(os, r);
+            os.flush();
+        });
+    };
+
+    double plain = encode(discard);
+    report("streaming write", payload, plain);
+    double checksummed = encode(serialization::checksumming_sink(discard));
+    report("streaming write (checksummed blocks)", payload, checksummed);
+
+    printf("%-40s %10.1f ms/GB\n", "checksum overhead", (checksummed - plain) / payload * (1 << 30) * 1e3);
+}
+
+struct bench_message
+{
+    int64_t             id = 0;
+    std::vector<char>   body;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, bench_message& r)
+{
+    visitor(r.id, "id");
+    visitor(r.body, "body");
+}
+
+// request/response style encoding: a stream per message, its bytes handed off and dropped
+inline void bench_pooled_buffers()
+{
+    for (size_t payload : { size_t(64), size_t(1024), size_t(64 * 1024) })
+    {
+        bench_message message;
+        message.body.assign(payload - sizeof(int64_t) - sizeof(serialization::size_type), 'm');
+        const size_t messages = std::min<size_t>(2000000, (256 << 20) / payload);
+        const size_t runs = 3; // measure_seconds() default
+
+        size_t sent = 0;
+        char name[64];
+        snprintf(name, sizeof(name), "%zu B messages (fresh buffer)", payload);
+        size_t before = instrumentation::allocation_count();
+        report_rate(name, messages, "msgs", measure_seconds([&]
+        {
+            for (size_t n = 0; n < messages; ++n)
+            {
+                message.id = static_cast<int64_t>(n);
+                serialization::output_stream os;
+                serialization::write(os, message);
+                serialization::bytes_t bytes = os.detach();
+                sent += bytes.size();
+            }
+        }));
+        report_allocations(name, (instrumentation::allocation_count() - before) / runs, messages);
+
+        snprintf(name, sizeof(name), "%zu B messages (pooled buffer)", payload);
+        before = instrumentation::allocation_count();
+        report_rate(name, messages, "msgs", measure_seconds([&]
+        {
+            for (size_t n = 0; n < messages; ++n)
+            {
+                message.id = static_cast<int64_t>(n);
+                serialization::pooled_output_stream os;
+                serialization::write(os, message);
+                sent += os.size();
+            }
+        }));
+        report_allocations(name, (instrumentation::allocation_count() - before) / runs, messages);
+
+        if (sent != 2 * runs * messages * payload)
+            printf("unexpected size %zu\n", sent);
+    }
+}
+
+// synced game-like state: a few nested records of which one field changes per tick
+struct bench_state
+{
+    int64_t         tick;
+    bench_nested    players[8];
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, bench_state& r)
+{
+    visitor(r.tick, "tick");
+    for (bench_nested& player : r.players)
+        visitor(player, "player");
+}
+
+inline void bench_delta()
+{
+    const size_t ticks = 1000 * 1000;
+
+    bench_state state = bench_state();
+    bench_state baseline = state;
+    serialization::output_stream os;
+    size_t full_bytes = 0, delta_bytes = 0;
+
+    report_rate("state sync (full record)", ticks, "ticks", measure_seconds([&]
+    {
+        for (size_t tick = 0; tick < ticks; ++tick)
+        {
+            state.tick = static_cast<int64_t>(tick);
+            state.players[tick % 8].x = tick * 0.5;
+            os.clear();
+            serialization::write(os, state);
+            full_bytes = os.size();
+        }
+    }));
+
+    report_rate("state sync (delta)", ticks, "ticks", measure_seconds([&]
+    {
+        for (size_t tick = 0; tick < ticks; ++tick)
+        {
+            state.tick = static_cast<int64_t>(tick);
+            state.players[tick % 8].x = tick * 0.5;
+            os.clear();
+            serialization::write_delta(os, state, baseline);
+            baseline.tick = state.tick;
+            baseline.players[tick % 8].x = state.players[tick % 8].x;
+            delta_bytes = os.size();
+        }
+    }));
+
+    printf("%-40s %10zu B\n", "full record per tick", full_bytes);
+    printf("%-40s %10zu B\n", "delta per tick", delta_bytes);
+}
+
+inline void run_all()
+{
+    bench_output_stream();
+    bench_checked_read();
+    bench_vector();
+    bench_varint();
+    bench_dict_backends();
+    bench_dict_scalars();
+    bench_dict_versioning();
+    bench_dict_json();
+    bench_compiled_schema();
+    bench_columns();
+    bench_record_view();
+    bench_parallel();
+    bench_compression();
+    bench_checksum();
+    bench_pooled_buffers();
+    bench_delta();
+}
+
+} // bench
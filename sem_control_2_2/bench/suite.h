@@ -0,0 +1,394 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <array>
+
+#include "alloc_count.h"
+#include "columns.h"
+#include "dict.h"
+#include "tagged.h"
+#include "task.h"
+
+// Throughput suite: binary, tagged and dict round-trips of a few record shapes, over batches from
+// 16 B to 64 MB of encoded payload. Prints one CSV row per (format, type, size, operation):
+//
+//  format,type,payload_bytes,records,op,ns_per_record,mb_per_s,allocs_per_record
+//
+// payload_bytes is the batch size bucket: each batch has as many records as take about that many
+// bytes in the binary encoding, whatever the format, so rows of one type line up across formats.
+// mb_per_s is computed from the bytes the row's format actually encoded; dicts have no encoding,
+// their rows use the binary size of the records they hold.
+// Keep the columns stable, runs of two builds are diffed.
+
+namespace suite
+{
+
+// plain fields without padding: compiled into a single memcpy run
+struct pod_record
+{
+    int32_t a;
+    int32_t b;
+    double  c;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, pod_record& r)
+{
+    visitor(r.a, "a");
+    visitor(r.b, "b");
+    visitor(r.c, "c");
+}
+
+// the same fields without reflect(): written by the raw POD path, one memcpy per record
+struct raw_pod_record
+{
+    int32_t a;
+    int32_t b;
+    double  c;
+};
+
+// padded and not a POD: written field by field
+struct reflected_record
+{
+    int32_t id      = 0;
+    double  value   = 0;
+    char    tag     = 0;
+    bool    flag    = false;
+    int64_t stamp   = 0;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, reflected_record& r)
+{
+    visitor(r.id, "id");
+    visitor(r.value, "value");
+    visitor(r.tag, "tag");
+    visitor(r.flag, "flag");
+    visitor(r.stamp, "stamp");
+}
+
+struct nested_record
+{
+    int32_t             id = 0;
+    reflected_record    inner;
+    pod_record          pod;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, nested_record& r)
+{
+    visitor(r.id, "id");
+    visitor(r.inner, "inner");
+    visitor(r.pod, "pod");
+}
+
+// variable size fields, binary only: dicts don't store sequences
+struct container_record
+{
+    std::string             name;
+    std::array<int32_t, 3>  triple = {};
+    std::vector<float>      samples;
+    reflected_record        inner;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, container_record& r)
+{
+    visitor(r.name, "name");
+    visitor(r.triple, "triple");
+    visitor(r.samples, "samples");
+    visitor(r.inner, "inner");
+}
+
+// versioning: written by the newer version, read by the older one that lacks `extra`
+// and has `legacy`, which the writer doesn't know about
+struct versioned_record_v1
+{
+    int32_t a       = 0;
+    double  b       = 0;
+    int64_t extra   = 0;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, versioned_record_v1& r)
+{
+    visitor(r.a, "a");
+    visitor(r.b, "b");
+    visitor(r.extra, "extra");
+}
+
+struct versioned_record_v0
+{
+    int32_t a       = 0;
+    double  b       = 0;
+    int16_t legacy  = 0;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, versioned_record_v0& r)
+{
+    visitor(r.a, "a");
+    visitor(r.b, "b");
+    visitor(r.legacy, "legacy");
+}
+
+inline void fill(pod_record& r, size_t n)
+{
+    r.a = static_cast<int32_t>(n);
+    r.b = static_cast<int32_t>(n * 7);
+    r.c = n * 0.5;
+}
+
+inline void fill(raw_pod_record& r, size_t n)
+{
+    r.a = static_cast<int32_t>(n);
+    r.b = static_cast<int32_t>(n * 7);
+    r.c = n * 0.5;
+}
+
+inline void fill(reflected_record& r, size_t n)
+{
+    r.id    = static_cast<int32_t>(n);
+    r.value = n * 0.25;
+    r.tag   = static_cast<char>('a' + n % 26);
+    r.flag  = n % 2 == 0;
+    r.stamp = static_cast<int64_t>(n) * 1000;
+}
+
+inline void fill(nested_record& r, size_t n)
+{
+    r.id = static_cast<int32_t>(n);
+    fill(r.inner, n);
+    fill(r.pod, n);
+}
+
+inline void fill(container_record& r, size_t n)
+{
+    r.name = "record " + std::to_string(n);
+    r.triple = {{ static_cast<int32_t>(n), 1, 2 }};
+    r.samples.assign(n % 8, n * 0.125f);
+    fill(r.inner, n);
+}
+
+inline void fill(versioned_record_v1& r, size_t n)
+{
+    r.a     = static_cast<int32_t>(n);
+    r.b     = n * 0.5;
+    r.extra = static_cast<int64_t>(n);
+}
+
+template <class T>
+std::vector<T> make_batch(size_t records)
+{
+    std::vector<T> batch(records);
+    for (size_t n = 0; n < records; ++n)
+        fill(batch[n], n);
+    return batch;
+}
+
+// records needed for about `payload` bytes of binary encoding, at least one
+template <class T>
+size_t records_for(size_t payload)
+{
+    std::vector<T> sample = make_batch<T>(64);
+    size_t bytes = 0;
+    for (T const& r : sample)
+        bytes += serialization::measure(r);
+    size_t records = payload * sample.size() / bytes;
+    return records != 0 ? records : 1;
+}
+
+struct measurement
+{
+    double seconds;      // per iteration
+    double allocations;  // per iteration
+};
+
+// runs f until it has taken min_seconds (after one warm-up run), at most max_iterations times
+template <class F>
+measurement run(F&& f, double min_seconds = 0.2, size_t max_iterations = 1000000)
+{
+    f();
+
+    size_t iterations = 0;
+    size_t allocations = instrumentation::allocation_count();
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed(0);
+    do
+    {
+        f();
+        ++iterations;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    while (elapsed.count() < min_seconds && iterations < max_iterations);
+
+    allocations = instrumentation::allocation_count() - allocations;
+    return measurement{ elapsed.count() / iterations, double(allocations) / iterations };
+}
+
+inline void print_header()
+{
+    printf("format,type,payload_bytes,records,op,ns_per_record,mb_per_s,allocs_per_record\n");
+}
+
+// bytes: encoded size of the batch, for the throughput column
+inline void print_row(const char* format, const char* type, size_t payload, size_t records, size_t bytes,
+                      const char* op, measurement const& m)
+{
+    printf("%s,%s,%zu,%zu,%s,%.2f,%.2f,%.3f\n", format, type, payload, records, op,
+           m.seconds * 1e9 / records, bytes / m.seconds / (1024 * 1024), m.allocations / records);
+    fflush(stdout);
+}
+
+template <class T>
+void binary_round_trip(const char* type, size_t payload)
+{
+    size_t records = records_for<T>(payload);
+    std::vector<T> batch = make_batch<T>(records);
+
+    serialization::bytes_t encoded;
+    measurement write = run([&]
+    {
+        serialization::output_stream os;
+        for (T const& r : batch)
+            serialization::write(os, r);
+        encoded = os.detach();
+    });
+
+    std::vector<T> decoded(records);
+    measurement read = run([&]
+    {
+        serialization::input_stream is(encoded);
+        for (T& r : decoded)
+            serialization::read(is, r);
+    });
+
+    print_row("binary", type, payload, records, encoded.size(), "write", write);
+    print_row("binary", type, payload, records, encoded.size(), "read", read);
+}
+
+// versioned batches go through the columnar format, the binary one that matches fields by name
+inline void columns_versioned(size_t payload)
+{
+    size_t records = records_for<versioned_record_v1>(payload);
+    std::vector<versioned_record_v1> batch = make_batch<versioned_record_v1>(records);
+
+    serialization::bytes_t encoded;
+    measurement write = run([&]
+    {
+        serialization::output_stream os;
+        serialization::write_columns(os, batch);
+        encoded = os.detach();
+    });
+
+    std::vector<versioned_record_v0> decoded;
+    measurement read = run([&]
+    {
+        serialization::input_stream is(encoded);
+        serialization::read_columns(is, decoded);
+    });
+
+    print_row("columns", "versioned", payload, records, encoded.size(), "write", write);
+    print_row("columns", "versioned", payload, records, encoded.size(), "read", read);
+}
+
+// field-id tagged records, versioned ones are written as v1 and read as v0
+template <class T, class R = T>
+void tagged_round_trip(const char* type, size_t payload)
+{
+    size_t records = records_for<T>(payload);
+    std::vector<T> batch = make_batch<T>(records);
+
+    serialization::bytes_t encoded;
+    measurement write = run([&]
+    {
+        serialization::output_stream os;
+        for (T const& r : batch)
+            serialization::write_tagged(os, r);
+        encoded = os.detach();
+    });
+
+    std::vector<R> decoded(records);
+    measurement read = run([&]
+    {
+        serialization::input_stream is(encoded);
+        for (R& r : decoded)
+            serialization::read_tagged(is, r);
+    });
+
+    print_row("tagged", type, payload, records, encoded.size(), "write", write);
+    print_row("tagged", type, payload, records, encoded.size(), "read", read);
+}
+
+template <class T, class R = T>
+void dict_round_trip(const char* type, size_t payload)
+{
+    size_t records = records_for<T>(payload);
+    std::vector<T> batch = make_batch<T>(records);
+
+    std::vector<std::string> keys(records);
+    for (size_t n = 0; n < records; ++n)
+        keys[n] = std::to_string(n);
+
+    serialization::dict d;
+    measurement write = run([&]
+    {
+        d = serialization::dict();
+        for (size_t n = 0; n < records; ++n)
+            serialization::write(serialization::add_child(d, keys[n]), batch[n]);
+    });
+
+    std::vector<R> decoded(records);
+    measurement read = run([&]
+    {
+        for (size_t n = 0; n < records; ++n)
+            serialization::read(*serialization::find_child(d, keys[n]), decoded[n]);
+    });
+
+    size_t bytes = 0;
+    for (T const& r : batch)
+        bytes += serialization::measure(r);
+
+    print_row("dict", type, payload, records, bytes, "write", write);
+    print_row("dict", type, payload, records, bytes, "read", read);
+}
+
+// payloads 16 B, 256 B, ... 16 MB, 64 MB. Dict trees take ~50x the memory of their binary
+// form, so dict rows stop at max_dict_payload.
+inline void run_all(size_t max_payload = 64 << 20, size_t max_dict_payload = 4 << 20)
+{
+    std::vector<size_t> payloads;
+    for (size_t payload = 16; payload <= max_payload; payload *= 16)
+        payloads.push_back(payload);
+    if (payloads.back() != max_payload)
+        payloads.push_back(max_payload);
+
+    print_header();
+    for (size_t payload : payloads)
+    {
+        binary_round_trip<raw_pod_record>("raw_pod", payload);
+        binary_round_trip<pod_record>("pod", payload);
+        binary_round_trip<reflected_record>("reflected", payload);
+        binary_round_trip<nested_record>("nested", payload);
+        binary_round_trip<container_record>("containers", payload);
+        columns_versioned(payload);
+        tagged_round_trip<pod_record>("pod", payload);
+        tagged_round_trip<reflected_record>("reflected", payload);
+        tagged_round_trip<nested_record>("nested", payload);
+        tagged_round_trip<container_record>("containers", payload);
+        tagged_round_trip<versioned_record_v1, versioned_record_v0>("versioned", payload);
+
+        if (payload > max_dict_payload)
+            continue;
+
+        dict_round_trip<pod_record>("pod", payload);
+        dict_round_trip<reflected_record>("reflected", payload);
+        dict_round_trip<nested_record>("nested", payload);
+        dict_round_trip<versioned_record_v1, versioned_record_v0>("versioned", payload);
+    }
+}
+
+} // suite
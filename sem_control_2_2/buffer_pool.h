@@ -0,0 +1,147 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <cstddef>
+
+#include "io_streams.h"
+
+namespace serialization
+{
+	// Thread-local pool of byte buffers, for encoding many messages of similar size without an
+	// allocation each. Buffers are bucketed by capacity in power of two size classes, from
+	// min_capacity up to max_capacity; a class keeps at most max_per_class buffers, larger
+	// buffers and the surplus are freed.
+	class buffer_pool
+	{
+	public:
+		static const size_t min_capacity	= 64;
+		static const size_t max_capacity	= 16 << 20;
+		static const size_t max_per_class	= 8;
+		// acquire() takes buffers at most this many classes (4x) above the one asked for, so a
+		// small request doesn't pin a large buffer
+		static const size_t max_class_excess	= 2;
+
+		// empty buffer with room for at least size_hint bytes: the smallest pooled one that is
+		// large enough and not much larger, or a new one rounded up to its size class
+		static bytes_t acquire(size_t size_hint = 0)
+		{
+			size_t wanted = size_class(size_hint);
+			if (wanted < classes)
+			{
+				auto& buckets = pooled();
+				for (size_t c = wanted; c < classes && c <= wanted + max_class_excess; ++c)
+				{
+					if (!buckets[c].empty())
+					{
+						bytes_t buffer = std::move(buckets[c].back());
+						buckets[c].pop_back();
+						return buffer;
+					}
+				}
+			}
+
+			bytes_t buffer;
+			buffer.reserve(wanted < classes ? min_capacity << wanted : size_hint);
+			return buffer;
+		}
+
+		// takes the buffer back for reuse by this thread
+		static void release(bytes_t&& buffer)
+		{
+			if (buffer.capacity() < min_capacity || buffer.capacity() > max_capacity)
+				return;
+
+			// the class the buffer can fully serve
+			size_t c = size_class(buffer.capacity());
+			if ((min_capacity << c) > buffer.capacity())
+				--c;
+
+			auto& bucket = pooled()[c];
+			if (bucket.size() == max_per_class)
+				return;
+			buffer.clear();
+			bucket.push_back(std::move(buffer));
+		}
+
+		// frees the buffers pooled by this thread
+		static void clear()
+		{
+			for (auto& bucket : pooled())
+				bucket.clear();
+		}
+
+		// buffers pooled by this thread
+		static size_t size()
+		{
+			size_t count = 0;
+			for (auto const& bucket : pooled())
+				count += bucket.size();
+			return count;
+		}
+
+	private:
+		static const size_t classes = 19; // 64 B ... 16 MB
+
+		// smallest class holding size bytes, classes if none does
+		static size_t size_class(size_t size)
+		{
+			size_t c = 0;
+			while (c < classes && (min_capacity << c) < size)
+				++c;
+			return c;
+		}
+
+		struct buckets_t
+		{
+			buckets_t()
+			{
+				for (auto& bucket : buckets)
+					bucket.reserve(max_per_class);
+			}
+
+			std::vector<bytes_t>& operator[](size_t c)
+			{
+				return buckets[c];
+			}
+
+			std::vector<bytes_t>* begin()	{ return buckets; }
+			std::vector<bytes_t>* end()		{ return buckets + classes; }
+
+			std::vector<bytes_t> buckets[classes];
+		};
+
+		static buckets_t& pooled()
+		{
+			thread_local buckets_t buckets;
+			return buckets;
+		}
+	};
+
+	// in-memory output_stream whose buffer comes from the thread's buffer_pool and goes back to
+	// it when the stream is destroyed, so encoding a message allocates nothing in steady state:
+	//
+	//   pooled_output_stream os(expected_size);
+	//   write(os, message);
+	//   send(os.data());
+	//
+	// A buffer taken with detach() can be handed back with buffer_pool::release().
+	template<class encoding_t>
+	struct basic_pooled_output_stream : basic_output_stream<encoding_t>
+	{
+		explicit basic_pooled_output_stream(size_t size_hint = 0)
+			: basic_output_stream<encoding_t>(buffer_pool::acquire(size_hint))
+		{
+		}
+
+		basic_pooled_output_stream(basic_pooled_output_stream&&) = default;
+
+		~basic_pooled_output_stream()
+		{
+			buffer_pool::release(this->detach());
+		}
+	};
+
+	typedef basic_pooled_output_stream<fixed_width_encoding>	pooled_output_stream;
+	typedef basic_pooled_output_stream<compact_encoding>		compact_pooled_output_stream;
+} // serialization
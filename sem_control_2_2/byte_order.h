@@ -0,0 +1,57 @@
+#pragma once 
+#include <type_traits>
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+
+namespace serialization
+{
+	// Multi-byte scalars are written little endian. On little endian hosts that is their in-memory
+	// form and they are copied as is; big endian hosts swap them on the way in and out.
+	const bool host_is_little_endian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+	template<class T>
+	struct needs_byte_swap
+		: std::integral_constant<bool, !host_is_little_endian && (sizeof(T) > 1)
+		                               && (std::is_arithmetic<T>::value || std::is_enum<T>::value)>
+	{
+	};
+
+	inline uint8_t byte_swap(uint8_t value)		{ return value; }
+	inline uint16_t byte_swap(uint16_t value)	{ return __builtin_bswap16(value); }
+	inline uint32_t byte_swap(uint32_t value)	{ return __builtin_bswap32(value); }
+	inline uint64_t byte_swap(uint64_t value)	{ return __builtin_bswap64(value); }
+
+	// value converted between host and wire byte order (the conversion is its own inverse)
+	template<class T>
+	typename std::enable_if<!needs_byte_swap<T>::value, T>::type
+	to_wire_order(const T& value)
+	{
+		return value;
+	}
+
+	template<class T>
+	typename std::enable_if<needs_byte_swap<T>::value, T>::type
+	to_wire_order(const T& value)
+	{
+		typedef typename std::conditional<sizeof(T) == 2, uint16_t,
+		        typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type>::type bits_t;
+		static_assert(sizeof(T) == sizeof(bits_t), "unsupported scalar size");
+
+		bits_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		bits = byte_swap(bits);
+
+		T result;
+		memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	// converts a whole array, a plain loop the compiler turns into vector shuffles
+	template<class T>
+	void to_wire_order(const T* in, T* out, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+			out[i] = to_wire_order(in[i]);
+	}
+} // serialization
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+#include "byte_order.h"
+#include "crc32c.h"
+#include "io_streams.h"
+#include "parallel.h"
+
+namespace serialization
+{
+
+// Integrity stage between a streaming output_stream and its sink. The stream's chunks are cut
+// into blocks of at most block_size bytes, each sent after a header with its checksum:
+//
+//  per block:  uint32_t size, uint32_t crc32c of the bytes, bytes
+//
+// The checksum is computed as each chunk is handed over, while it is still in cache, and the
+// bytes are passed on without being copied. Put it after a compressing_sink to protect
+// compressed blocks. frame_blocks() does the same for a buffer in memory, verify_blocks() checks
+// and strips the framing.
+
+namespace details
+{
+
+// a block size the header can hold, and that makes progress
+inline size_t checksum_block_size(size_t block_size)
+{
+    return std::max<size_t>(1, std::min<size_t>(block_size, UINT32_MAX));
+}
+
+} // details
+
+struct checksumming_sink
+{
+    static const size_t default_block_size = 64 * 1024;
+
+    // block_size is clamped to [1, UINT32_MAX]
+    explicit checksumming_sink(sink_t next, size_t block_size = default_block_size)
+        : next_(move(next))
+        , block_size_(details::checksum_block_size(block_size))
+    {
+    }
+
+    void operator()(const byte_t* data, size_t size)
+    {
+        while (size != 0)
+        {
+            size_t block_size = std::min(size, block_size_);
+            uint32_t header[2] = { to_wire_order(static_cast<uint32_t>(block_size)),
+                                   to_wire_order(crc32c(data, block_size)) };
+            next_(reinterpret_cast<const byte_t*>(header), sizeof(header));
+            next_(data, block_size);
+            data += block_size;
+            size -= block_size;
+        }
+    }
+
+private:
+    sink_t  next_;
+    size_t  block_size_;
+};
+
+// data framed as a checksumming_sink with this block_size frames it
+inline bytes_t frame_blocks(bytes_t const& data, size_t block_size = checksumming_sink::default_block_size)
+{
+    const size_t header_size = 2 * sizeof(uint32_t);
+    block_size = details::checksum_block_size(block_size);
+
+    bytes_t framed;
+    framed.reserve(data.size() + (data.size() + block_size - 1) / block_size * header_size);
+    checksumming_sink sink([&framed](const byte_t* bytes, size_t size)
+    {
+        framed.insert(framed.end(), bytes, bytes + size);
+    }, block_size);
+    sink(data.data(), data.size());
+    return framed;
+}
+
+// copies the bytes of the blocks written through a checksumming_sink into out,
+// false if the framing is malformed or a block doesn't match its checksum
+inline bool verify_blocks(const byte_t* data, size_t size, bytes_t& out, size_t threads = 1)
+{
+    struct block
+    {
+        const byte_t*   bytes;
+        size_t          size;
+        uint32_t        crc;
+        size_t          offset;
+    };
+
+    std::vector<block> blocks;
+    size_t total = 0;
+    for (size_t offset = 0; offset != size; )
+    {
+        uint32_t header[2];
+        if (size - offset < sizeof(header))
+            return false;
+        memcpy(header, data + offset, sizeof(header));
+        offset += sizeof(header);
+
+        size_t block_size = to_wire_order(header[0]);
+        if (block_size > size - offset)
+            return false;
+
+        blocks.push_back(block{ data + offset, block_size, to_wire_order(header[1]), total });
+        offset += block_size;
+        total += block_size;
+    }
+
+    out.resize(total);
+
+    std::vector<char> valid(blocks.size(), 1);
+    details::parallel_for(blocks.size(), threads, [&](size_t index)
+    {
+        block const& b = blocks[index];
+        valid[index] = crc32c(b.bytes, b.size) == b.crc;
+        memcpy(out.data() + b.offset, b.bytes, b.size);
+    });
+
+    return std::find(valid.begin(), valid.end(), 0) == valid.end();
+}
+
+} // serialization
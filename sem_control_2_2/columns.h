@@ -0,0 +1,364 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstring>
+
+#include "task.h"
+
+namespace serialization
+{
+
+// Columnar batches of reflected records: every top-level field of the record type
+// becomes a column holding that field of all records, one after another.
+//
+//  size_type   record count
+//  size_type   column count
+//  per column: field name (std::string), size_type column size in bytes
+//  column data, in the same order
+//
+// Columns of raw fields are contiguous arrays and are bulk copied; read_column()
+// decodes a single column and skips the others. Reading validates the header and the
+// column sizes, so a corrupted batch is reported rather than read past its end.
+
+namespace details
+{
+
+struct columns_header
+{
+    size_type                   records;
+    std::vector<std::string>    names;
+    std::vector<size_type>      offsets; // from the end of the header
+    size_type                   size;    // of all the column data
+};
+
+// false if the header is truncated or its columns run past the end of the stream.
+// Every value takes at least a byte, so a batch can't hold more records than bytes.
+template <class E>
+bool read_columns_header(basic_input_stream<E>& is, columns_header& header)
+{
+    size_type columns;
+    if (!read_checked(is, header.records) || header.records > is.remaining()
+        || !read_checked(is, columns) || columns > is.remaining())
+        return false;
+
+    header.names.resize(columns);
+    header.offsets.resize(columns);
+    header.size = 0;
+    for (size_t column = 0; column < columns; ++column)
+    {
+        size_type bytes;
+        if (!read_checked(is, header.names[column]) || !read_checked(is, bytes))
+            return false;
+        if (header.size > is.remaining() || bytes > is.remaining() - header.size)
+            return false;
+
+        header.offsets[column] = header.size;
+        header.size += bytes;
+    }
+    return true;
+}
+
+template <class E>
+basic_input_stream<E> column_stream(columns_header const& header, const byte_t* data, size_t column)
+{
+    size_type end = column + 1 < header.offsets.size() ? header.offsets[column + 1] : header.size;
+    return basic_input_stream<E>(data + header.offsets[column], end - header.offsets[column]);
+}
+
+template <class T>
+std::vector<std::string> field_names(const T& record)
+{
+    std::vector<std::string> names;
+    reflect([&names](auto&, field_name name){ names.push_back(name.str()); }, const_cast<T&>(record));
+    return names;
+}
+
+// column names of a batch: the fields of a default constructed T, or of the first record for
+// types without a default constructor (an empty batch of those has no columns)
+template <class T>
+std::vector<std::string> batch_field_names(const std::vector<T>&, std::true_type)
+{
+    return field_names(T());
+}
+
+template <class T>
+std::vector<std::string> batch_field_names(const std::vector<T>& records, std::false_type)
+{
+    return records.empty() ? std::vector<std::string>() : field_names(records.front());
+}
+
+typedef std::pair<bool, std::vector<std::vector<field_run>>> columns_runs;
+
+template <class T, class E>
+columns_runs compile_columns(std::false_type)
+{
+    return columns_runs(false, std::vector<std::vector<field_run>>());
+}
+
+template <class T, class E>
+columns_runs compile_columns(std::true_type)
+{
+    T sample = T();
+    std::vector<std::vector<field_run>> fields;
+    bool compiled = compiled_schema<T, E>() != nullptr;
+    reflect([&sample, &fields](auto& field, field_name)
+    {
+        schema_builder builder(&sample, sizeof(T));
+        compile_field<E>(builder, field);
+        fields.push_back(builder.runs());
+    }, sample);
+    return columns_runs(compiled, fields);
+}
+
+// memcpy runs of every top-level field, for record types compiled_schema() can flatten,
+// so columns are gathered and scattered without walking reflect() per record
+template <class T, class E>
+std::vector<std::vector<field_run>> const* columns_layout()
+{
+    static const columns_runs layout = compile_columns<T, E>(std::is_default_constructible<T>());
+    return layout.first ? &layout.second : nullptr;
+}
+
+// memcpy with the common field sizes spelled out, so they compile to plain moves
+inline void copy_run(char* to, const char* from, size_t size)
+{
+    switch (size)
+    {
+    case 1: memcpy(to, from, 1); break;
+    case 2: memcpy(to, from, 2); break;
+    case 4: memcpy(to, from, 4); break;
+    case 8: memcpy(to, from, 8); break;
+    default: memcpy(to, from, size); break;
+    }
+}
+
+inline size_t runs_size(std::vector<field_run> const& runs)
+{
+    size_t size = 0;
+    for (field_run const& run : runs)
+        size += run.size;
+    return size;
+}
+
+template <class E, class F>
+bool read_column_values(basic_input_stream<E>& is, std::vector<F>& values)
+{
+    return values.empty() || read_elements_checked(is, &values[0], values.size(), elements_encoding<E, F>());
+}
+
+// std::vector<bool> has no contiguous storage
+template <class E>
+bool read_column_values(basic_input_stream<E>& is, std::vector<bool>& values)
+{
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        bool value;
+        if (!read_checked(is, value))
+            return false;
+        values[i] = value;
+    }
+    return true;
+}
+
+// a column can hold `records` values of `value_size` bytes each, or of at least a byte each
+// when value_size is 0 (not fixed size)
+inline bool column_fits(size_t column_size, size_t records, size_t value_size)
+{
+    return value_size ? column_size % value_size == 0 && column_size / value_size == records : column_size >= records;
+}
+
+} // details
+
+template <class E, class T>
+void write_columns(basic_output_stream<E>& os, const std::vector<T>& records)
+{
+    std::vector<std::string> names = details::batch_field_names(records, std::is_default_constructible<T>());
+
+    std::vector<bytes_t> columns(names.size());
+    if (auto layout = details::columns_layout<T, E>())
+    {
+        for (size_t column = 0; column < columns.size(); ++column)
+        {
+            columns[column].resize(records.size() * details::runs_size((*layout)[column]));
+            byte_t* to = columns[column].data();
+            for (const T& record : records)
+            {
+                for (details::field_run const& run : (*layout)[column])
+                {
+                    details::copy_run(to, reinterpret_cast<const char*>(&record) + run.offset, run.size);
+                    to += run.size;
+                }
+            }
+        }
+    }
+    else
+    {
+        std::vector<basic_output_stream<E>> streams(names.size());
+        for (const T& record : records)
+        {
+            size_t column = 0;
+            reflect([&streams, &column](auto& field, field_name)
+            {
+                write(streams[column++], field);
+            }, const_cast<T&>(record));
+        }
+
+        for (size_t column = 0; column < columns.size(); ++column)
+            columns[column] = streams[column].detach();
+    }
+
+    size_t size = (2 + names.size()) * sizeof(size_type) + measure(names);
+    for (bytes_t const& column : columns)
+        size += column.size();
+    os.reserve_extra(size);
+
+    write(os, static_cast<size_type>(records.size()));
+    write(os, static_cast<size_type>(names.size()));
+    for (size_t column = 0; column < names.size(); ++column)
+    {
+        write(os, names[column]);
+        write(os, static_cast<size_type>(columns[column].size()));
+    }
+
+    for (bytes_t const& column : columns)
+        os.write(column.data(), column.size());
+}
+
+// columns are matched to fields by name, fields without a column keep the value a default
+// constructed T has. Returns false if the batch is malformed, records are unspecified then.
+template <class E, class T>
+bool read_columns(basic_input_stream<E>& is, std::vector<T>& records)
+{
+    static_assert(std::is_default_constructible<T>::value, "records are default constructed, then read column by column");
+
+    details::columns_header header;
+    if (!details::read_columns_header(is, header))
+        return false;
+    const byte_t* data = is.position();
+
+    const T default_record = T();
+    std::vector<std::string> names = details::field_names(default_record);
+    std::vector<basic_input_stream<E>> columns;
+    std::vector<basic_input_stream<E>*> column_of_field(names.size(), nullptr);
+    columns.reserve(names.size());
+
+    auto layout = details::columns_layout<T, E>();
+    for (size_t field = 0; field < names.size(); ++field)
+    {
+        for (size_t column = 0; column < header.names.size(); ++column)
+        {
+            if (header.names[column] != names[field])
+                continue;
+
+            columns.push_back(details::column_stream<E>(header, data, column));
+            column_of_field[field] = &columns.back();
+
+            size_t value_size = layout ? details::runs_size((*layout)[field]) : 0;
+            if (!details::column_fits(columns.back().remaining(), header.records, value_size))
+                return false;
+            break;
+        }
+    }
+
+    // the fields of default_record, walked alongside each record for the fields without a column
+    std::vector<const void*> defaults;
+    reflect([&defaults](auto& value, field_name){ defaults.push_back(&value); }, const_cast<T&>(default_record));
+
+    records.resize(header.records);
+    if (layout)
+    {
+        for (size_t field = 0; field < names.size(); ++field)
+        {
+            basic_input_stream<E>* column = column_of_field[field];
+            if (!column)
+                continue;
+
+            const byte_t* from = column->position();
+            for (T& record : records)
+            {
+                for (details::field_run const& run : (*layout)[field])
+                {
+                    details::copy_run(reinterpret_cast<char*>(&record) + run.offset, from, run.size);
+                    from += run.size;
+                }
+            }
+        }
+
+        if (columns.size() != names.size())
+        {
+            for (T& record : records)
+            {
+                size_t field = 0;
+                reflect([&](auto& value, field_name)
+                {
+                    typedef typename std::remove_reference<decltype(value)>::type value_t;
+                    if (!column_of_field[field])
+                        value = *static_cast<const value_t*>(defaults[field]);
+                    ++field;
+                }, record);
+            }
+        }
+    }
+    else
+    {
+        bool ok = true;
+        for (T& record : records)
+        {
+            size_t field = 0;
+            reflect([&](auto& value, field_name)
+            {
+                typedef typename std::remove_reference<decltype(value)>::type value_t;
+                if (basic_input_stream<E>* column = column_of_field[field])
+                    ok = ok && details::read_checked(*column, value);
+                else
+                    value = *static_cast<const value_t*>(defaults[field]);
+                ++field;
+            }, record);
+
+            if (!ok)
+                return false;
+        }
+
+        for (basic_input_stream<E> const& column : columns)
+            if (column.remaining() != 0)
+                return false;
+    }
+
+    is.skip(header.size);
+    return true;
+}
+
+// reads the values of a single field, returns false if the batch has no such column or is malformed
+template <class E, class F>
+bool read_column(basic_input_stream<E>& is, const std::string& name, std::vector<F>& values)
+{
+    values.clear();
+
+    details::columns_header header;
+    if (!details::read_columns_header(is, header))
+        return false;
+    const byte_t* data = is.position();
+    is.skip(header.size);
+
+    for (size_t column = 0; column < header.names.size(); ++column)
+    {
+        if (header.names[column] != name)
+            continue;
+
+        basic_input_stream<E> column_is = details::column_stream<E>(header, data, column);
+        if (!details::column_fits(column_is.remaining(), header.records, serialized_size<F, E>()))
+            return false;
+
+        values.resize(header.records);
+        if (details::read_column_values(column_is, values) && column_is.remaining() == 0)
+            return true;
+
+        values.clear();
+        return false;
+    }
+    return false;
+}
+
+} // serialization
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include "byte_order.h"
+#include "io_streams.h"
+#include "lz.h"
+#include "parallel.h"
+
+namespace serialization
+{
+
+// Block compression stage between a streaming output_stream and its sink. The stream's chunks
+// are cut into blocks of at most block_size bytes, each compressed on its own with lz:
+//
+//  per block:  uint32_t raw size, uint32_t stored size, stored bytes
+//
+// A block that doesn't shrink is stored as is (stored size == raw size). Blocks don't
+// reference each other, so decompress_blocks() can expand them in parallel. The sizes are
+// little endian whatever the host.
+
+namespace details
+{
+
+// a block size the header can hold, and that makes progress
+inline size_t compressed_block_size(size_t block_size)
+{
+    return std::max<size_t>(1, std::min<size_t>(block_size, UINT32_MAX));
+}
+
+} // details
+
+struct compressing_sink
+{
+    static const size_t default_block_size = 64 * 1024;
+
+    // block_size is clamped to [1, UINT32_MAX]
+    explicit compressing_sink(sink_t next, size_t block_size = default_block_size)
+        : next_(move(next))
+        , block_size_(details::compressed_block_size(block_size))
+    {
+    }
+
+    void operator()(const byte_t* data, size_t size)
+    {
+        while (size != 0)
+        {
+            size_t raw_size = std::min(size, block_size_);
+            write_block(data, raw_size);
+            data += raw_size;
+            size -= raw_size;
+        }
+    }
+
+private:
+    void write_block(const byte_t* data, size_t raw_size)
+    {
+        const size_t header_size = 2 * sizeof(uint32_t);
+        block_.resize(header_size + lz::max_compressed_size(raw_size));
+
+        size_t stored_size = lz::compress(data, raw_size, block_.data() + header_size, table_);
+        if (stored_size >= raw_size)
+        {
+            stored_size = raw_size;
+            memcpy(block_.data() + header_size, data, raw_size);
+        }
+
+        uint32_t header[2] = { to_wire_order(static_cast<uint32_t>(raw_size)), to_wire_order(static_cast<uint32_t>(stored_size)) };
+        memcpy(block_.data(), header, header_size);
+        next_(block_.data(), header_size + stored_size);
+    }
+
+private:
+    sink_t          next_;
+    size_t          block_size_;
+    bytes_t         block_;
+    lz::hash_table  table_;
+};
+
+// expands the blocks written through a compressing_sink into out, false if data is malformed.
+// block_size is the one the sink used: headers claiming larger blocks, or more bytes than the
+// stored ones can expand to, are rejected before anything is allocated.
+inline bool decompress_blocks(const byte_t* data, size_t size, bytes_t& out, size_t threads = 1,
+                              size_t block_size = compressing_sink::default_block_size)
+{
+    struct block
+    {
+        const byte_t*   stored;
+        size_t          stored_size;
+        size_t          raw_offset;
+        size_t          raw_size;
+    };
+
+    std::vector<block> blocks;
+    size_t raw_total = 0;
+    for (size_t offset = 0; offset != size; )
+    {
+        uint32_t header[2];
+        if (size - offset < sizeof(header))
+            return false;
+        memcpy(header, data + offset, sizeof(header));
+        offset += sizeof(header);
+
+        size_t raw_size = to_wire_order(header[0]), stored_size = to_wire_order(header[1]);
+        if (stored_size > size - offset || stored_size > raw_size || raw_size > block_size)
+            return false;
+        if (stored_size < raw_size && raw_size > lz::max_decompressed_size(stored_size))
+            return false;
+
+        blocks.push_back(block{ data + offset, stored_size, raw_total, raw_size });
+        offset += stored_size;
+        raw_total += raw_size;
+    }
+
+    out.resize(raw_total);
+
+    std::vector<char> valid(blocks.size(), 1);
+    details::parallel_for(blocks.size(), threads, [&](size_t index)
+    {
+        block const& b = blocks[index];
+        if (b.stored_size == b.raw_size)
+            memcpy(out.data() + b.raw_offset, b.stored, b.raw_size);
+        else
+            valid[index] = lz::decompress(b.stored, b.stored_size, out.data() + b.raw_offset, b.raw_size);
+    });
+
+    return std::find(valid.begin(), valid.end(), 0) == valid.end();
+}
+
+} // serialization
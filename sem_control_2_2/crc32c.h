@@ -0,0 +1,91 @@
+#pragma once
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace serialization
+{
+	// CRC-32C (Castagnoli), as iSCSI and ext4 use it: crc32c("123456789") == 0xe3069283.
+	// Uses the SSE4.2 crc32 instruction when the CPU has it, slicing-by-8 tables otherwise.
+	// SSE4.2 isn't part of the x86-64 baseline, so unlike the SSE2 code elsewhere it is
+	// selected at run time rather than by compiler flags.
+
+	namespace details
+	{
+		struct crc32c_tables
+		{
+			uint32_t table[8][256];
+
+			crc32c_tables()
+			{
+				for (uint32_t byte = 0; byte < 256; ++byte)
+				{
+					uint32_t crc = byte;
+					for (int bit = 0; bit < 8; ++bit)
+						crc = crc >> 1 ^ (0x82f63b78u & (0u - (crc & 1)));
+					table[0][byte] = crc;
+				}
+				for (uint32_t byte = 0; byte < 256; ++byte)
+					for (int slice = 1; slice < 8; ++slice)
+						table[slice][byte] = table[slice - 1][byte] >> 8 ^ table[0][table[slice - 1][byte] & 0xff];
+			}
+		};
+
+		// crc is the running, not inverted, value
+		inline uint32_t crc32c_table(uint32_t crc, const unsigned char* p, size_t size)
+		{
+			static const crc32c_tables tables;
+			auto const& t = tables.table;
+
+			for (; size >= 8; p += 8, size -= 8)
+			{
+				uint32_t low = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24);
+				crc = t[7][low & 0xff] ^ t[6][low >> 8 & 0xff] ^ t[5][low >> 16 & 0xff] ^ t[4][low >> 24]
+					^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+			}
+			for (; size != 0; ++p, --size)
+				crc = crc >> 8 ^ t[0][(crc ^ *p) & 0xff];
+			return crc;
+		}
+
+#if defined(__x86_64__)
+		__attribute__((target("sse4.2")))
+		inline uint32_t crc32c_sse42(uint32_t crc, const unsigned char* p, size_t size)
+		{
+			uint64_t crc64 = crc;
+			for (; size >= 8; p += 8, size -= 8)
+			{
+				uint64_t word;
+				memcpy(&word, p, sizeof(word));
+				crc64 = _mm_crc32_u64(crc64, word);
+			}
+			crc = static_cast<uint32_t>(crc64);
+			for (; size != 0; ++p, --size)
+				crc = _mm_crc32_u8(crc, *p);
+			return crc;
+		}
+
+		inline bool has_sse42()
+		{
+			static const bool has = __builtin_cpu_supports("sse4.2");
+			return has;
+		}
+#endif
+	} // details
+
+	// crc of the bytes, continuing from the crc of the bytes before them:
+	// crc32c(b, n, crc32c(a, m)) == crc32c of a followed by b
+	inline uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+#if defined(__x86_64__)
+		if (details::has_sse42())
+			return ~details::crc32c_sse42(~crc, p, size);
+#endif
+		return ~details::crc32c_table(~crc, p, size);
+	}
+} // serialization
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <cstring>
+
+#include "task.h"
+
+namespace serialization
+{
+
+// Deltas of a record against a baseline, for syncing state that changes a few fields at a time:
+//
+//  delta:      changed bitmap, values of the changed fields
+//  bitmap:     a bit per field visited by reflect(), in order, least significant bit first,
+//              (fields + 7) / 8 bytes
+//
+// Values are written as write() encodes them, except reflected fields, which are deltas
+// themselves, so a change deep in a nested record costs its own bitmaps and value only.
+// An unchanged record is its bitmap. read_delta() applies a delta on top of the baseline it was
+// made against; both sides must use the same version of the type.
+//
+// Fields are compared by value (plain ones byte for byte), so finding what changed still walks
+// the whole record, but only changed fields are encoded and sent.
+
+namespace details
+{
+
+template <class T>
+typename std::enable_if<is_plain<T>::value, bool>::type fields_equal(const T& a, const T& b);
+template <class T>
+typename std::enable_if<is_sequence<T>::value, bool>::type fields_equal(const T& a, const T& b);
+template <class T>
+typename std::enable_if<is_std_array<T>::value && !is_plain<T>::value, bool>::type fields_equal(const T& a, const T& b);
+template <class T>
+typename std::enable_if<is_reflected<T>::value, bool>::type fields_equal(const T& a, const T& b);
+
+// the field of `other` at the same offset as `field` has in `object`
+template <class F, class T>
+const F& same_field(const F& field, const T& object, const T& other)
+{
+    size_t offset = reinterpret_cast<const char*>(&field) - reinterpret_cast<const char*>(&object);
+    return *reinterpret_cast<const F*>(reinterpret_cast<const char*>(&other) + offset);
+}
+
+template <class T, class = void>
+struct has_equal : std::false_type {};
+
+template <class T>
+struct has_equal<T, decltype(void(std::declval<const T&>() == std::declval<const T&>()))> : std::true_type {};
+
+// types whose bytes hold nothing but the value, so memcmp compares values and not padding.
+// float and double are compared bitwise too: a change from 0.0 to -0.0, or to another NaN,
+// is still a change to send.
+template <class T>
+struct is_bitwise_comparable
+    : std::integral_constant<bool, std::has_unique_object_representations<T>::value
+                                   || std::is_same<T, float>::value || std::is_same<T, double>::value>
+{
+};
+
+struct bitwise_comparison {};
+struct element_comparison {};
+struct operator_comparison {};
+struct no_comparison {};
+
+// padded plain types are compared with their operator==, or by element for arrays of them.
+// Without either they can't be compared and always count as changed.
+template <class T>
+using plain_comparison = typename std::conditional<is_bitwise_comparable<T>::value, bitwise_comparison,
+                         typename std::conditional<std::is_array<T>::value || is_std_array<T>::value, element_comparison,
+                         typename std::conditional<has_equal<T>::value, operator_comparison,
+                                                   no_comparison>::type>::type>::type;
+
+template <class T>
+bool plain_equal(const T& a, const T& b, bitwise_comparison)
+{
+    return memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+template <class T>
+bool plain_equal(const T& a, const T& b, element_comparison)
+{
+    return std::equal(std::begin(a), std::end(a), std::begin(b), [](auto const& x, auto const& y)
+    {
+        return fields_equal(x, y);
+    });
+}
+
+template <class T>
+bool plain_equal(const T& a, const T& b, operator_comparison)
+{
+    return a == b;
+}
+
+template <class T>
+bool plain_equal(const T&, const T&, no_comparison)
+{
+    return false;
+}
+
+template <class T>
+typename std::enable_if<is_plain<T>::value, bool>::type
+fields_equal(const T& a, const T& b)
+{
+    return plain_equal(a, b, plain_comparison<T>());
+}
+
+template <class T>
+bool elements_equal(const T& a, const T& b, bulk_elements)
+{
+    return a.size() == 0 || memcmp(a.data(), b.data(), a.size() * sizeof(typename T::value_type)) == 0;
+}
+
+template <class T, class Tag>
+bool elements_equal(const T& a, const T& b, Tag)
+{
+    typedef typename T::value_type value_t;
+    return std::equal(a.begin(), a.end(), b.begin(), [](const value_t& x, const value_t& y)
+    {
+        return fields_equal(x, y);
+    });
+}
+
+template <class T>
+typename std::enable_if<is_sequence<T>::value, bool>::type
+fields_equal(const T& a, const T& b)
+{
+    typedef typename T::value_type value_t;
+
+    // std::vector<bool> has no data(), its elements are compared one by one
+    const bool bulk = is_bitwise_comparable<value_t>::value && !std::is_same<value_t, bool>::value;
+    return a.size() == b.size()
+        && elements_equal(a, b, typename std::conditional<bulk, bulk_elements, each_element>::type());
+}
+
+template <class T>
+typename std::enable_if<is_std_array<T>::value && !is_plain<T>::value, bool>::type
+fields_equal(const T& a, const T& b)
+{
+    return elements_equal(a, b, each_element());
+}
+
+template <class T>
+typename std::enable_if<is_reflected<T>::value, bool>::type
+fields_equal(const T& a, const T& b)
+{
+    bool equal = true;
+    reflect([&](auto& field, field_name)
+    {
+        equal = equal && fields_equal(field, same_field(field, a, b));
+    }, const_cast<T&>(a));
+    return equal;
+}
+
+template <class T>
+size_t field_count(T& data)
+{
+    size_t count = 0;
+    reflect([&count](auto&, field_name){ ++count; }, data);
+    return count;
+}
+
+// bit per field, in place for up to 512 fields
+class delta_bitmap
+{
+public:
+    explicit delta_bitmap(size_t fields)
+        : size_((fields + 7) / 8)
+    {
+        if (size_ > sizeof(small_))
+            large_.resize(size_);
+        std::fill(data(), data() + size_, 0);
+    }
+
+    byte_t* data()
+    {
+        return large_.empty() ? small_ : large_.data();
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    void set(size_t field)
+    {
+        data()[field / 8] |= static_cast<byte_t>(1 << field % 8);
+    }
+
+    bool test(size_t field)
+    {
+        return (static_cast<unsigned char>(data()[field / 8]) >> field % 8 & 1) != 0;
+    }
+
+private:
+    size_t              size_;
+    byte_t              small_[64];
+    std::vector<byte_t> large_;
+};
+
+template <class E, class T>
+void write_delta_body(basic_output_stream<E>& os, const T& data, const T& baseline);
+template <class E, class T>
+void read_delta_body(basic_input_stream<E>& is, T& data);
+
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, void>::type
+write_delta_value(basic_output_stream<E>& os, const T& data, const T& baseline)
+{
+    write_delta_body(os, data, baseline);
+}
+
+template <class E, class T>
+typename std::enable_if<!is_reflected<T>::value, void>::type
+write_delta_value(basic_output_stream<E>& os, const T& data, const T&)
+{
+    write(os, data);
+}
+
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, void>::type
+read_delta_value(basic_input_stream<E>& is, T& data)
+{
+    read_delta_body(is, data);
+}
+
+template <class E, class T>
+typename std::enable_if<!is_reflected<T>::value, void>::type
+read_delta_value(basic_input_stream<E>& is, T& data)
+{
+    read(is, data);
+}
+
+template <class E, class T>
+void write_delta_body(basic_output_stream<E>& os, const T& data, const T& baseline)
+{
+    T& current = const_cast<T&>(data);
+    delta_bitmap changed(field_count(current));
+
+    size_t index = 0;
+    bool any = false;
+    reflect([&](auto& field, field_name)
+    {
+        if (!fields_equal(field, same_field(field, data, baseline)))
+        {
+            changed.set(index);
+            any = true;
+        }
+        ++index;
+    }, current);
+
+    os.write(changed.data(), changed.size());
+    if (!any)
+        return;
+
+    index = 0;
+    reflect([&](auto& field, field_name)
+    {
+        if (changed.test(index++))
+            write_delta_value(os, field, same_field(field, data, baseline));
+    }, current);
+}
+
+template <class E, class T>
+void read_delta_body(basic_input_stream<E>& is, T& data)
+{
+    delta_bitmap changed(field_count(data));
+    is.read(changed.data(), changed.size());
+
+    size_t index = 0;
+    reflect([&](auto& field, field_name)
+    {
+        if (changed.test(index++))
+            read_delta_value(is, field);
+    }, data);
+}
+
+} // details
+
+// writes the fields of data that differ from baseline
+template <class E, class T>
+void write_delta(basic_output_stream<E>& os, const T& data, const T& baseline)
+{
+    static_assert(is_reflected<T>::value, "deltas are made of the fields reflect() visits");
+    details::write_delta_body(os, data, baseline);
+}
+
+// applies a delta written by write_delta(), data must hold the baseline it was made against
+template <class E, class T>
+void read_delta(basic_input_stream<E>& is, T& data)
+{
+    static_assert(is_reflected<T>::value, "deltas are made of the fields reflect() visits");
+    details::read_delta_body(is, data);
+}
+
+} // serialization
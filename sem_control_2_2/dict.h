@@ -1,12 +1,114 @@
 #pragma once 
 #include <string>
+#include <string_view>
 #include <map>
+#include <deque>
+#include <unordered_set>
+#include <mutex>
+#include <functional>
+#include <type_traits>
 
 namespace serialization
 {
+	// Keys of dict children: every distinct name is copied once into a table that lives as long
+	// as the process, nodes keep views of it. Names are never dropped, so a process that parses
+	// dicts with unbounded sets of keys keeps them all.
+	namespace details
+	{
+		class dict_key_table
+		{
+		public:
+			static std::string_view intern(std::string_view name)
+			{
+				// names seen by this thread are found without taking the lock
+				thread_local std::unordered_set<std::string_view> seen;
+				auto it = seen.find(name);
+				if (it != seen.end())
+					return *it;
+
+				dict_key_table& table = instance();
+				std::lock_guard<std::mutex> lock(table.mutex_);
+				auto key = table.keys_.find(name);
+				if (key == table.keys_.end())
+				{
+					table.names_.emplace_back(name);
+					key = table.keys_.insert(table.names_.back()).first;
+				}
+				return *seen.insert(*key).first;
+			}
+
+		private:
+			static dict_key_table& instance()
+			{
+				static dict_key_table* table = new dict_key_table(); // never destroyed, views outlive static destructors
+				return *table;
+			}
+
+			std::mutex						mutex_;
+			std::deque<std::string>			names_;	// a deque doesn't move them, they back keys_ and every view
+			std::unordered_set<std::string_view>	keys_;
+		};
+	} // details
+
 	struct dict 
 	{
-		std::string					value;
-		std::map<std::string, dict>	children;
+		std::string							value;
+		std::map<std::string_view, dict>	children; // add_child() interns the keys, others must outlive the dict
+	};
+
+	// Dict node protocol, the read/write templates in task.h work with any node type providing it:
+	//   dict_value(d)               - the leaf value, something with data() and size()
+	//   set_dict_value(d, p, size)  - sets the leaf value
+	//   find_child(d, name)         - pointer-like handle to the child node, empty if there is none
+	//   add_child(d, name)          - adds a child node and returns it
+	//   close_children(d)           - called once all children of d were added
+	//   for_each_child(d, f)        - calls f(name, child) for every child of d, in the node's order
+	// Names are passed as std::string_view (field_name converts to one), a backend only copies a
+	// name when it stores it. dict interns each name once per process, arena_dict takes the copy
+	// from its arena, flat_dict interns each name once per tree.
+
+	template<class T>
+	struct is_dict_node : std::false_type
+	{
+	};
+
+	template<>
+	struct is_dict_node<dict> : std::true_type
+	{
 	};
+
+	inline std::string const& dict_value(dict const& d)
+	{
+		return d.value;
+	}
+
+	inline void set_dict_value(dict& d, const char* data, size_t size)
+	{
+		d.value.assign(data, size);
+	}
+
+	inline dict const* find_child(dict const& d, std::string_view name)
+	{
+		auto it = d.children.find(name);
+		return it != d.children.end() ? &it->second : nullptr;
+	}
+
+	inline dict& add_child(dict& d, std::string_view name)
+	{
+		auto it = d.children.lower_bound(name);
+		if (it == d.children.end() || it->first != name)
+			it = d.children.emplace_hint(it, std::piecewise_construct, std::forward_as_tuple(details::dict_key_table::intern(name)), std::forward_as_tuple());
+		return it->second;
+	}
+
+	inline void close_children(dict&)
+	{
+	}
+
+	template<class F>
+	void for_each_child(dict const& d, F&& f)
+	{
+		for (auto const& child : d.children)
+			f(child.first, child.second);
+	}
 } // serialization
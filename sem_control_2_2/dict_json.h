@@ -0,0 +1,425 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "dict.h"
+
+namespace serialization
+{
+	// Text form of a dict, a JSON subset:
+	//   a node with children is an object, keys in the dict's order,
+	//   any other node is a string holding its value.
+	// The parser also takes bare numbers (kept verbatim), true/false (stored as 1/0, like bool
+	// fields) and null (empty value), so hand-written configs needn't quote everything.
+	// Arrays aren't supported, a dict has nothing to map them to.
+
+	namespace details
+	{
+		// JSON requires escaping quotes, backslashes and control characters
+		inline bool needs_json_escape(char c)
+		{
+			return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+		}
+
+		inline void append_json_string(std::string& out, const char* p, size_t size)
+		{
+			static const char hex[] = "0123456789abcdef";
+
+			out += '"';
+			const char* end = p + size;
+			while (p != end)
+			{
+				const char* run = p;
+				while (p != end && !needs_json_escape(*p))
+					++p;
+				out.append(run, p - run);
+				if (p == end)
+					break;
+
+				char c = *p++;
+				switch (c)
+				{
+				case '"':	out += "\\\""; break;
+				case '\\':	out += "\\\\"; break;
+				case '\n':	out += "\\n"; break;
+				case '\r':	out += "\\r"; break;
+				case '\t':	out += "\\t"; break;
+				default:
+					out += "\\u00";
+					out += hex[(c >> 4) & 0xf];
+					out += hex[c & 0xf];
+				}
+			}
+			out += '"';
+		}
+
+		// walks the tree through the dict node protocol, so it works with every backend
+		template<class D>
+		void append_json(std::string& out, D const& d, size_t indent)
+		{
+			bool first = true;
+			for_each_child(d, [&out, &first, indent](std::string_view name, auto const& child)
+			{
+				out += first ? "{\n" : ",\n";
+				first = false;
+				out.append(indent + 2, ' ');
+				append_json_string(out, name.data(), name.size());
+				out += ": ";
+				append_json(out, child, indent + 2);
+			});
+
+			if (first)
+			{
+				auto const& value = dict_value(d);
+				append_json_string(out, value.data(), value.size());
+				return;
+			}
+
+			out += '\n';
+			out.append(indent, ' ');
+			out += '}';
+		}
+
+		// first '"' or '\\' in [p, end), 16 bytes at a time with SSE2
+		inline const char* find_quote_or_escape(const char* p, const char* end)
+		{
+#if defined(__SSE2__)
+			const __m128i quote		= _mm_set1_epi8('"');
+			const __m128i backslash	= _mm_set1_epi8('\\');
+			for (; end - p >= 16; p += 16)
+			{
+				__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+				unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash))));
+				if (mask != 0)
+					return p + __builtin_ctz(mask);
+			}
+#endif
+			for (; p != end; ++p)
+				if (*p == '"' || *p == '\\')
+					return p;
+			return end;
+		}
+
+		inline bool is_json_space(char c)
+		{
+			return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+		}
+
+		// first non-whitespace character in [p, end). Indentation runs are skipped 16 bytes at a time.
+		inline const char* skip_json_space(const char* p, const char* end)
+		{
+#if defined(__SSE2__)
+			while (end - p >= 16 && is_json_space(*p))
+			{
+				__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+				__m128i space = _mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))),
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))));
+				unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(space)) & 0xffff;
+				if (mask != 0)
+					return p + __builtin_ctz(mask);
+				p += 16;
+			}
+#endif
+			while (p != end && is_json_space(*p))
+				++p;
+			return p;
+		}
+
+		inline int hex_digit(char c)
+		{
+			if (c >= '0' && c <= '9')
+				return c - '0';
+			if (c >= 'a' && c <= 'f')
+				return c - 'a' + 10;
+			if (c >= 'A' && c <= 'F')
+				return c - 'A' + 10;
+			return -1;
+		}
+
+		inline void append_utf8(std::string& out, uint32_t code_point)
+		{
+			if (code_point < 0x80)
+				out += static_cast<char>(code_point);
+			else if (code_point < 0x800)
+			{
+				out += static_cast<char>(0xc0 | (code_point >> 6));
+				out += static_cast<char>(0x80 | (code_point & 0x3f));
+			}
+			else if (code_point < 0x10000)
+			{
+				out += static_cast<char>(0xe0 | (code_point >> 12));
+				out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+				out += static_cast<char>(0x80 | (code_point & 0x3f));
+			}
+			else
+			{
+				out += static_cast<char>(0xf0 | (code_point >> 18));
+				out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+				out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+				out += static_cast<char>(0x80 | (code_point & 0x3f));
+			}
+		}
+
+		class json_parser
+		{
+		public:
+			// nesting deeper than this is rejected rather than overflowing the stack
+			static const size_t max_depth = 256;
+
+			json_parser(const char* data, size_t size)
+				: p_(data)
+				, end_(data + size)
+				, depth_(0)
+			{
+			}
+
+			template<class D>
+			bool parse(D&& root)
+			{
+				if (!parse_value(root))
+					return false;
+				p_ = skip_json_space(p_, end_);
+				return p_ == end_;
+			}
+
+		private:
+			template<class D>
+			bool parse_value(D&& node)
+			{
+				p_ = skip_json_space(p_, end_);
+				if (p_ == end_)
+					return false;
+
+				if (*p_ == '{')
+					return parse_object(node);
+
+				const char* value;
+				size_t size;
+				if (*p_ == '"')
+				{
+					if (!parse_string(value, size))
+						return false;
+				}
+				else if (!parse_literal(value, size))
+					return false;
+
+				set_dict_value(node, value, size);
+				return true;
+			}
+
+			template<class D>
+			bool parse_object(D&& node)
+			{
+				if (++depth_ > max_depth)
+					return false;
+				++p_;
+
+				p_ = skip_json_space(p_, end_);
+				if (p_ != end_ && *p_ == '}')
+				{
+					++p_;
+					--depth_;
+					close_children(node);
+					return true;
+				}
+
+				for (;;)
+				{
+					p_ = skip_json_space(p_, end_);
+					const char* key;
+					size_t key_size;
+					if (p_ == end_ || *p_ != '"' || !parse_string(key, key_size))
+						return false;
+					key_.assign(key, key_size); // the name is only needed until add_child() returns
+
+					p_ = skip_json_space(p_, end_);
+					if (p_ == end_ || *p_ != ':')
+						return false;
+					++p_;
+
+					if (!parse_value(add_child(node, key_)))
+						return false;
+
+					p_ = skip_json_space(p_, end_);
+					if (p_ == end_)
+						return false;
+					if (*p_ == '}')
+						break;
+					if (*p_ != ',')
+						return false;
+					++p_;
+				}
+
+				++p_;
+				--depth_;
+				close_children(node);
+				return true;
+			}
+
+			// strings without escapes are returned in place, others are unescaped into scratch_
+			bool parse_string(const char*& value, size_t& size)
+			{
+				const char* begin = ++p_;
+				const char* stop = find_quote_or_escape(p_, end_);
+				if (stop != end_ && *stop == '"')
+				{
+					value = begin;
+					size = stop - begin;
+					p_ = stop + 1;
+					return true;
+				}
+
+				scratch_.clear();
+				for (;;)
+				{
+					scratch_.append(p_, stop - p_);
+					p_ = stop;
+					if (p_ == end_)
+						return false;
+					if (*p_ == '"')
+						break;
+					if (!parse_escape())
+						return false;
+					stop = find_quote_or_escape(p_, end_);
+				}
+
+				++p_;
+				value = scratch_.data();
+				size = scratch_.size();
+				return true;
+			}
+
+			bool parse_escape()
+			{
+				if (end_ - p_ < 2)
+					return false;
+				char c = p_[1];
+				p_ += 2;
+				switch (c)
+				{
+				case '"':	scratch_ += '"'; return true;
+				case '\\':	scratch_ += '\\'; return true;
+				case '/':	scratch_ += '/'; return true;
+				case 'b':	scratch_ += '\b'; return true;
+				case 'f':	scratch_ += '\f'; return true;
+				case 'n':	scratch_ += '\n'; return true;
+				case 'r':	scratch_ += '\r'; return true;
+				case 't':	scratch_ += '\t'; return true;
+				case 'u':	break;
+				default:	return false;
+				}
+
+				uint32_t code_point;
+				if (!parse_hex4(code_point))
+					return false;
+
+				// a high surrogate must be followed by an escaped low one
+				if (code_point >= 0xd800 && code_point < 0xdc00)
+				{
+					uint32_t low;
+					if (end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u')
+						return false;
+					p_ += 2;
+					if (!parse_hex4(low) || low < 0xdc00 || low >= 0xe000)
+						return false;
+					code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+				}
+				else if (code_point >= 0xdc00 && code_point < 0xe000)
+					return false;
+
+				append_utf8(scratch_, code_point);
+				return true;
+			}
+
+			bool parse_hex4(uint32_t& value)
+			{
+				if (end_ - p_ < 4)
+					return false;
+				value = 0;
+				for (int i = 0; i < 4; ++i)
+				{
+					int digit = hex_digit(*p_++);
+					if (digit < 0)
+						return false;
+					value = value << 4 | static_cast<uint32_t>(digit);
+				}
+				return true;
+			}
+
+			// numbers are kept as written, from_chars parses them when the field is read
+			bool parse_literal(const char*& value, size_t& size)
+			{
+				const char* begin = p_;
+				while (p_ != end_ && *p_ != ',' && *p_ != '}' && !is_json_space(*p_))
+					++p_;
+				size = p_ - begin;
+				if (size == 0)
+					return false;
+
+				if (size == 4 && memcmp(begin, "true", 4) == 0)
+					value = "1", size = 1;
+				else if (size == 5 && memcmp(begin, "false", 5) == 0)
+					value = "0", size = 1;
+				else if (size == 4 && memcmp(begin, "null", 4) == 0)
+					value = "", size = 0;
+				else
+				{
+					for (const char* c = begin; c != p_; ++c)
+						if (!((*c >= '0' && *c <= '9') || *c == '-' || *c == '+' || *c == '.' || *c == 'e' || *c == 'E'))
+							return false;
+					value = begin;
+				}
+				return true;
+			}
+
+		private:
+			const char*	p_;
+			const char*	end_;
+			size_t		depth_;
+			std::string	key_;
+			std::string	scratch_;
+		};
+	} // details
+
+	// appends the text form of d, any dict node (a dict, an arena_dict, a flat_dict's root()), to out
+	template<class D>
+	void write_json(std::string& out, D const& d)
+	{
+		details::append_json(out, d, 0);
+		out += '\n';
+	}
+
+	template<class D>
+	std::string to_json(D const& d)
+	{
+		std::string out;
+		write_json(out, d);
+		return out;
+	}
+
+	// builds the tree under root through the dict node protocol, so it works with every backend.
+	// Returns false on malformed input, root is then left partially filled.
+	template<class D>
+	typename std::enable_if<is_dict_node<typename std::decay<D>::type>::value, bool>::type
+	from_json(const char* data, size_t size, D&& root)
+	{
+		return details::json_parser(data, size).parse(root);
+	}
+
+	template<class D>
+	typename std::enable_if<is_dict_node<typename std::decay<D>::type>::value, bool>::type
+	from_json(std::string const& text, D&& root)
+	{
+		return from_json(text.data(), text.size(), root);
+	}
+} // serialization
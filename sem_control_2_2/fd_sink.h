@@ -0,0 +1,38 @@
+#pragma once 
+#include <system_error>
+#include <cerrno>
+#include <cstddef>
+
+#include <unistd.h>
+
+namespace serialization
+{
+	// sink for a streaming output_stream, writes every chunk to a file descriptor
+	struct fd_sink
+	{
+		explicit fd_sink(int fd)
+			: fd_(fd)
+		{
+		}
+
+		void operator()(const char* data, size_t size) const
+		{
+			while (size != 0)
+			{
+				ssize_t written = ::write(fd_, data, size);
+				if (written < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					throw std::system_error(errno, std::generic_category(), "fd_sink");
+				}
+				data += written;
+				size -= static_cast<size_t>(written);
+			}
+		}
+
+	private:
+		int fd_;
+	};
+
+} // serialization
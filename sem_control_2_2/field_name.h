@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <stdint.h>
+#include <cstddef>
+
+namespace serialization
+{
+	// FNV-1a, usable at compile time
+	constexpr uint32_t field_name_hash(const char* name, size_t size)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ static_cast<unsigned char>(name[i])) * 16777619u;
+		return hash;
+	}
+
+	// Name of a field, as reflect() passes it to visitors: visitor(r.a, "a").
+	// Built from a literal, it only points at it and its size and hash are constant expressions;
+	// visitors that ignore the name cost nothing. Visitors that keep the name copy it: dict makes a
+	// std::string key per node (see the node protocol in dict.h). Names built at run time (from a
+	// std::string) must not outlive the call.
+	class field_name
+	{
+	public:
+		template<size_t N>
+		constexpr field_name(const char (&name)[N])
+			: data_(name)
+			, size_(N - 1)
+			, hash_(field_name_hash(name, N - 1))
+		{
+		}
+
+		field_name(std::string const& name)
+			: field_name(name.data(), name.size())
+		{
+		}
+
+		constexpr field_name(const char* data, size_t size)
+			: data_(data)
+			, size_(size)
+			, hash_(field_name_hash(data, size))
+		{
+		}
+
+		constexpr const char* data() const
+		{
+			return data_;
+		}
+
+		constexpr size_t size() const
+		{
+			return size_;
+		}
+
+		constexpr uint32_t hash() const
+		{
+			return hash_;
+		}
+
+		// dict backends take names as string_views
+		constexpr operator std::string_view() const
+		{
+			return std::string_view(data_, size_);
+		}
+
+		std::string str() const
+		{
+			return std::string(data_, size_);
+		}
+
+	private:
+		const char*	data_;
+		size_t		size_;
+		uint32_t	hash_;
+	};
+} // serialization
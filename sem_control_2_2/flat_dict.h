@@ -0,0 +1,272 @@
+#pragma once 
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <optional>
+#include <stdint.h>
+
+#include "dict.h"
+
+namespace serialization
+{
+	// dict stored in a few flat arrays instead of one heap node per entry:
+	// nodes live in one vector, keys are interned to ids, each node's children are a
+	// contiguous range of node indices sorted by key id (looked up with a binary search),
+	// leaf values are slices of one string.
+	// A flat_dict is built once, by writing into its root.
+	struct flat_dict
+	{
+		struct node_ref;
+		struct const_node_ref;
+
+		// leaf value, a slice of the value arena
+		struct value_ref
+		{
+			const char* data() const
+			{
+				return data_;
+			}
+
+			size_t size() const
+			{
+				return size_;
+			}
+
+			const char*	data_;
+			size_t		size_;
+		};
+
+		flat_dict()
+			: nodes_(1, node())
+		{
+		}
+
+		// key_ids_ points into key_names_, a copy needs its own index
+		flat_dict(flat_dict const& other)
+			: nodes_(other.nodes_)
+			, children_(other.children_)
+			, pending_(other.pending_)
+			, values_(other.values_)
+			, key_names_(other.key_names_)
+		{
+			for (size_t key = 0; key < key_names_.size(); ++key)
+				key_ids_.emplace(key_names_[key], static_cast<uint32_t>(key));
+		}
+
+		flat_dict(flat_dict&&) = default;
+		flat_dict& operator=(flat_dict&&) = default;
+
+		flat_dict& operator=(flat_dict const& other)
+		{
+			return *this = flat_dict(other);
+		}
+
+		node_ref		root();
+		const_node_ref	root() const;
+
+		size_t size() const
+		{
+			return nodes_.size();
+		}
+
+		// node level access, used by the dict node protocol below
+
+		value_ref value(uint32_t index) const
+		{
+			node const& n = nodes_[index];
+			return value_ref{ values_.data() + n.value_offset, n.value_size };
+		}
+
+		void set_value(uint32_t index, const char* data, size_t size)
+		{
+			node& n = nodes_[index];
+			n.value_offset	= static_cast<uint32_t>(values_.size());
+			n.value_size	= static_cast<uint32_t>(size);
+			values_.append(data, size);
+		}
+
+		static const uint32_t npos = UINT32_MAX;
+
+		size_t child_count(uint32_t index) const
+		{
+			return nodes_[index].child_count;
+		}
+
+		// i-th child of a closed node, children are ordered by key id
+		uint32_t child(uint32_t index, size_t i) const
+		{
+			return children_[nodes_[index].first_child + i];
+		}
+
+		std::string_view key(uint32_t index) const
+		{
+			return key_names_[nodes_[index].key];
+		}
+
+		// npos if there is no such child
+		uint32_t find_child(uint32_t index, std::string_view name) const
+		{
+			auto key = key_ids_.find(name);
+			if (key == key_ids_.end())
+				return npos;
+
+			node const& n = nodes_[index];
+			auto begin	= children_.begin() + n.first_child;
+			auto end	= begin + n.child_count;
+			auto it = std::lower_bound(begin, end, key->second, [this](uint32_t child, uint32_t key)
+			{
+				return nodes_[child].key < key;
+			});
+			if (it == end || nodes_[*it].key != key->second)
+				return npos;
+			return *it;
+		}
+
+		// children are stacked in pending_ until their parent is closed
+		uint32_t add_child(uint32_t index, std::string_view name)
+		{
+			if (nodes_[index].child_count == 0)
+				nodes_[index].first_child = static_cast<uint32_t>(pending_.size());
+			++nodes_[index].child_count;
+
+			uint32_t child = static_cast<uint32_t>(nodes_.size());
+			nodes_.push_back(node());
+			nodes_.back().key = intern(name);
+			pending_.push_back(child);
+			return child;
+		}
+
+		void close_children(uint32_t index)
+		{
+			node& n = nodes_[index];
+			if (n.child_count == 0)
+				return;
+
+			auto begin = pending_.begin() + n.first_child;
+
+			n.first_child = static_cast<uint32_t>(children_.size());
+			children_.insert(children_.end(), begin, pending_.end());
+			pending_.erase(begin, pending_.end());
+
+			std::sort(children_.begin() + n.first_child, children_.end(), [this](uint32_t lhs, uint32_t rhs)
+			{
+				return nodes_[lhs].key < nodes_[rhs].key;
+			});
+		}
+
+	private:
+		struct node
+		{
+			uint32_t key			= 0;
+			uint32_t value_offset	= 0;
+			uint32_t value_size		= 0;
+			uint32_t first_child	= 0; // into children_, or into pending_ while the node is being built
+			uint32_t child_count	= 0;
+		};
+
+		uint32_t intern(std::string_view name)
+		{
+			auto it = key_ids_.find(name);
+			if (it != key_ids_.end())
+				return it->second;
+
+			key_names_.emplace_back(name);
+			return key_ids_.emplace(key_names_.back(), static_cast<uint32_t>(key_ids_.size())).first->second;
+		}
+
+	private:
+		std::vector<node>							nodes_;
+		std::vector<uint32_t>						children_;
+		std::vector<uint32_t>						pending_;
+		std::string									values_;
+		std::deque<std::string>						key_names_;	// a deque doesn't move them, they back key_ids_
+		std::unordered_map<std::string_view, uint32_t>	key_ids_;
+	};
+
+	struct flat_dict::node_ref
+	{
+		flat_dict*	dict;
+		uint32_t	index;
+	};
+
+	struct flat_dict::const_node_ref
+	{
+		const_node_ref(flat_dict const* dict, uint32_t index)
+			: dict(dict)
+			, index(index)
+		{
+		}
+
+		const_node_ref(node_ref ref)
+			: dict(ref.dict)
+			, index(ref.index)
+		{
+		}
+
+		flat_dict const*	dict;
+		uint32_t			index;
+	};
+
+	inline flat_dict::node_ref flat_dict::root()
+	{
+		return node_ref{ this, 0 };
+	}
+
+	inline flat_dict::const_node_ref flat_dict::root() const
+	{
+		return const_node_ref(this, 0);
+	}
+
+	// dict node protocol, see dict.h
+
+	template<>
+	struct is_dict_node<flat_dict::node_ref> : std::true_type
+	{
+	};
+
+	template<>
+	struct is_dict_node<flat_dict::const_node_ref> : std::true_type
+	{
+	};
+
+	inline flat_dict::value_ref dict_value(flat_dict::const_node_ref d)
+	{
+		return d.dict->value(d.index);
+	}
+
+	inline void set_dict_value(flat_dict::node_ref d, const char* data, size_t size)
+	{
+		d.dict->set_value(d.index, data, size);
+	}
+
+	inline std::optional<flat_dict::const_node_ref> find_child(flat_dict::const_node_ref d, std::string_view name)
+	{
+		uint32_t child = d.dict->find_child(d.index, name);
+		if (child == flat_dict::npos)
+			return std::nullopt;
+		return flat_dict::const_node_ref(d.dict, child);
+	}
+
+	inline flat_dict::node_ref add_child(flat_dict::node_ref d, std::string_view name)
+	{
+		return flat_dict::node_ref{ d.dict, d.dict->add_child(d.index, name) };
+	}
+
+	inline void close_children(flat_dict::node_ref d)
+	{
+		d.dict->close_children(d.index);
+	}
+
+	template<class F>
+	void for_each_child(flat_dict::const_node_ref d, F&& f)
+	{
+		for (size_t i = 0; i < d.dict->child_count(d.index); ++i)
+		{
+			uint32_t child = d.dict->child(d.index, i);
+			f(d.dict->key(child), flat_dict::const_node_ref(d.dict, child));
+		}
+	}
+} // serialization
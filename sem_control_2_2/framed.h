@@ -0,0 +1,168 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+
+#include "byte_order.h"
+#include "task.h"
+
+namespace serialization
+{
+
+// Framed container with random access to records:
+//
+//  per record: size_type payload size, payload (the record written with write())
+//  index:      uint64_t offset of every record from the start of the container
+//  trailer:    uint64_t record count, uint64_t offset of the index
+//
+// The index and trailer are written as raw little endian 8-byte values even on compact
+// streams, so the reader finds them from the end and seeks to record K in O(1).
+// The reader checks the trailer and index against the container size when it is opened
+// and each record's frame when it is read, so a corrupted container is reported.
+
+template <class E>
+struct basic_framed_writer
+{
+    explicit basic_framed_writer(basic_output_stream<E>& os)
+        : os_(os)
+        , position_(0)
+    {
+    }
+
+    template <class T>
+    void append(const T& record)
+    {
+        record_.clear();
+        write(record_, record);
+
+        header_.clear();
+        write(header_, static_cast<size_type>(record_.size()));
+
+        offsets_.push_back(position_);
+        os_.write(header_.data().data(), header_.size());
+        os_.write(record_.data().data(), record_.size());
+        position_ += header_.size() + record_.size();
+    }
+
+    // writes the index and trailer, nothing may be appended afterwards
+    void finish()
+    {
+        uint64_t trailer[2] = { to_wire_order(static_cast<uint64_t>(offsets_.size())), to_wire_order(position_) };
+
+        to_wire_order(offsets_.data(), offsets_.data(), offsets_.size());
+        if (!offsets_.empty())
+            os_.write(offsets_.data(), offsets_.size() * sizeof(uint64_t));
+        os_.write(trailer, sizeof(trailer));
+    }
+
+private:
+    basic_output_stream<E>& os_;
+    basic_output_stream<E>  record_; // reused for every record
+    basic_output_stream<E>  header_;
+    uint64_t                position_;
+    std::vector<uint64_t>   offsets_;
+};
+
+template <class E>
+struct basic_framed_reader
+{
+    // borrows the bytes, they must outlive the reader
+    basic_framed_reader(const byte_t* data, size_t size)
+        : data_(data)
+        , index_(nullptr)
+        , count_(0)
+    {
+        const size_t trailer = 2 * sizeof(uint64_t);
+        if (size < trailer)
+            return;
+
+        uint64_t count, index_offset;
+        memcpy(&count, data + size - trailer, sizeof(count));
+        memcpy(&index_offset, data + size - sizeof(index_offset), sizeof(index_offset));
+        count = to_wire_order(count);
+        index_offset = to_wire_order(index_offset);
+
+        if (index_offset > size - trailer || (size - trailer - index_offset) / sizeof(uint64_t) != count
+            || (size - trailer - index_offset) % sizeof(uint64_t) != 0)
+            return;
+
+        index_ = data + index_offset;
+        count_ = count;
+    }
+
+    explicit basic_framed_reader(bytes_t const& from)
+        : basic_framed_reader(from.data(), from.size())
+    {
+    }
+
+    explicit basic_framed_reader(mapped_file const& file)
+        : basic_framed_reader(file.data(), file.size())
+    {
+    }
+
+    // the mapping would be gone before the first read
+    basic_framed_reader(mapped_file&&) = delete;
+
+    // false if the trailer doesn't describe an index that fits the container
+    bool valid() const
+    {
+        return index_ != nullptr;
+    }
+
+    // records in the container, 0 if it isn't valid()
+    size_t size() const
+    {
+        return count_;
+    }
+
+    // stream over the payload of record k, empty if its frame is out of the records' bounds
+    basic_input_stream<E> record(size_t k) const
+    {
+        assert(k < count_);
+
+        uint64_t offset;
+        memcpy(&offset, index_ + k * sizeof(uint64_t), sizeof(offset));
+        offset = to_wire_order(offset);
+        if (offset >= static_cast<uint64_t>(index_ - data_))
+            return basic_input_stream<E>(data_, 0);
+
+        basic_input_stream<E> header(data_ + offset, index_ - (data_ + offset));
+        size_type size;
+        if (!details::read_checked(header, size) || size > header.remaining())
+            return basic_input_stream<E>(data_, 0);
+
+        return basic_input_stream<E>(header.position(), size);
+    }
+
+    // false if the record's frame or payload is corrupt
+    template <class T>
+    bool read_record(size_t k, T& data) const
+    {
+        basic_input_stream<E> is = record(k);
+        return details::read_checked(is, data);
+    }
+
+    // calls f(k, record) for records [first, last), false if one of them is corrupt
+    template <class T, class F>
+    bool for_each(size_t first, size_t last, F f) const
+    {
+        T data;
+        for (size_t k = first; k < last; ++k)
+        {
+            if (!read_record(k, data))
+                return false;
+            f(k, data);
+        }
+        return true;
+    }
+
+private:
+    const byte_t*   data_;
+    const byte_t*   index_;
+    uint64_t        count_;
+};
+
+typedef basic_framed_writer<fixed_width_encoding>   framed_writer;
+typedef basic_framed_reader<fixed_width_encoding>   framed_reader;
+
+} // serialization
@@ -1,10 +1,16 @@
 #pragma once 
 #include <vector>
+#include <functional>
+#include <utility>
+#include <string>
+#include <system_error>
 #include <stdint.h>
 #include <assert.h>
 #include <cstddef>
 #include <cstring>
 
+#include "mapped_file.h"
+
 namespace serialization
 {
 	// binary io streams
@@ -13,24 +19,115 @@ namespace serialization
 
 	typedef uint64_t		size_type;
 
-	struct output_stream
+	// receives the encoded bytes of a streaming output_stream, one chunk at a time
+	typedef std::function<void(const byte_t* data, size_t size)>	sink_t;
+
+	// Stream encodings, chosen per stream at compile time:
+	// fixed_width_encoding writes integers as their sizeof(T) raw bytes,
+	// compact_encoding writes multi-byte integers as LEB128 varints (zigzag for signed ones).
+	struct fixed_width_encoding {};
+	struct compact_encoding {};
+
+	template<class encoding_t>
+	struct basic_output_stream
 	{
-		explicit output_stream(bytes_t&& from = bytes_t())
+		typedef encoding_t encoding;
+
+		// capacity is never grown below this, so tiny writes don't reallocate on every field
+		static const size_t min_capacity = 64;
+		static const size_t default_chunk_size = 64 * 1024;
+
+		explicit basic_output_stream(bytes_t&& from = bytes_t())
 			: buffer_(move(from))
 		{
 		}
 
+		// streaming mode: the buffer is bounded by chunk_size and handed to the sink whenever it fills up
+		explicit basic_output_stream(sink_t sink, size_t chunk_size = default_chunk_size)
+			: sink_(move(sink))
+		{
+			buffer_.reserve(chunk_size);
+		}
+
+		basic_output_stream(basic_output_stream&&) = default;
+
+		// flushes what is left in streaming mode. Exceptions from the sink can't leave a
+		// destructor and are dropped, so call flush() before to see them.
+		~basic_output_stream()
+		{
+			try
+			{
+				flush();
+			}
+			catch (...)
+			{
+				// call flush() explicitly to see sink errors
+			}
+		}
+
 		void write(const void* data, size_t size)
 		{
 			const byte_t* p = static_cast<const byte_t*>(data);
 
 			size_t old_size = buffer_.size();
-			buffer_.resize(old_size + size);
-			memcpy(buffer_.data() + old_size, p, size);
+			if (old_size + size > buffer_.capacity())
+				return write_overflow(p, size);
+
+			// appended rather than resized and copied over, so the bytes aren't zeroed first
+			buffer_.insert(buffer_.end(), p, p + size);
+		}
+
+		// hands the buffered bytes to the sink, does nothing for in-memory streams
+		void flush()
+		{
+			if (sink_ && !buffer_.empty())
+			{
+				sink_(buffer_.data(), buffer_.size());
+				buffer_.clear();
+			}
 		}
 
+		void reserve(size_t new_capacity)
+		{
+			buffer_.reserve(new_capacity);
+		}
+
+		// makes room for `extra` more bytes, following the growth policy.
+		// Streaming buffers never grow, so it is a no-op for them.
+		void reserve_extra(size_t extra)
+		{
+			if (!sink_ && buffer_.size() + extra > buffer_.capacity())
+				buffer_.reserve(grown_capacity(buffer_.size() + extra));
+		}
+
+		size_t capacity() const
+		{
+			return buffer_.capacity();
+		}
+
+		// bytes held in the buffer (not yet flushed, in streaming mode)
+		size_t size() const
+		{
+			return buffer_.size();
+		}
+
+		// in-memory streams only, a streaming buffer keeps its chunk capacity
+		void shrink_to_fit()
+		{
+			if (!sink_)
+				buffer_.shrink_to_fit();
+		}
+
+		// drops the buffered bytes, keeping the capacity for reuse
+		void clear()
+		{
+			buffer_.clear();
+		}
+
+		// in-memory streams only: a streaming one would lose its chunk buffer, flush() it instead
 		bytes_t detach()
 		{
+			assert(!sink_);
 			return move(buffer_);
 		}
 
@@ -39,19 +136,99 @@ namespace serialization
 			return buffer_;
 		}
 
+	private:
+		// slow path of write(), the buffer is full: grow it or, in streaming mode, flush it.
+		// Kept out of line so write() itself stays small enough to be inlined.
+		__attribute__((noinline)) void write_overflow(const byte_t* p, size_t size)
+		{
+			if (!sink_)
+				buffer_.reserve(grown_capacity(buffer_.size() + size));
+			else
+			{
+				flush();
+				if (size > buffer_.capacity())
+				{
+					sink_(p, size);
+					return;
+				}
+			}
+
+			buffer_.insert(buffer_.end(), p, p + size);
+		}
+
+		// geometric (x2) growth, independent of std::vector's own policy
+		size_t grown_capacity(size_t required) const
+		{
+			size_t new_capacity = buffer_.capacity() < min_capacity ? min_capacity : buffer_.capacity() * 2;
+			return new_capacity < required ? required : new_capacity;
+		}
+
 	private:
 		bytes_t	buffer_;
+		sink_t	sink_;
+	};
+
+	// errors reported by the checked read functions
+	enum class stream_errc
+	{
+		truncated = 1,
 	};
 
-	struct input_stream
+	struct stream_category_t : std::error_category
 	{
-		explicit input_stream(bytes_t const& from)
-			: begin_(from.data())
-			, end_  (from.data() + from.size())
-			, cur_  (from.data())
+		const char* name() const noexcept override
 		{
+			return "serialization";
 		}
 
+		std::string message(int ev) const override
+		{
+			switch (static_cast<stream_errc>(ev))
+			{
+			case stream_errc::truncated:
+				return "input stream is truncated";
+			}
+			return "unknown serialization error";
+		}
+	};
+
+	inline std::error_category const& stream_category()
+	{
+		static stream_category_t category;
+		return category;
+	}
+
+	inline std::error_code make_error_code(stream_errc e)
+	{
+		return std::error_code(static_cast<int>(e), stream_category());
+	}
+
+	template<class encoding_t>
+	struct basic_input_stream
+	{
+		typedef encoding_t encoding;
+
+		explicit basic_input_stream(bytes_t const& from)
+			: basic_input_stream(from.data(), from.size())
+		{
+		}
+
+		// borrows the bytes, they must outlive the stream
+		basic_input_stream(const byte_t* data, size_t size)
+			: begin_(data)
+			, end_  (data + size)
+			, cur_  (data)
+		{
+		}
+
+		explicit basic_input_stream(mapped_file const& file)
+			: basic_input_stream(file.data(), file.size())
+		{
+		}
+
+		// the mapping would be gone before the first read
+		basic_input_stream(mapped_file&&) = delete;
+
 		void read(void* to, size_t size)
 		{
 			assert(cur_ + size <= end_);
@@ -59,6 +236,23 @@ namespace serialization
 			cur_ += size;
 		}
 
+		size_t remaining() const
+		{
+			return end_ - cur_;
+		}
+
+		// direct access for decoders working on the bytes in place (varints)
+		byte_t const* position() const
+		{
+			return cur_;
+		}
+
+		void skip(size_t size)
+		{
+			assert(cur_ + size <= end_);
+			cur_ += size;
+		}
+
 	private:
 		byte_t const* begin_;
 		byte_t const* end_;
@@ -66,4 +260,18 @@ namespace serialization
 
 	};
 
+	typedef basic_output_stream<fixed_width_encoding>	output_stream;
+	typedef basic_input_stream<fixed_width_encoding>	input_stream;
+
+	typedef basic_output_stream<compact_encoding>		compact_output_stream;
+	typedef basic_input_stream<compact_encoding>		compact_input_stream;
+
 } // serialization
+
+namespace std
+{
+	template<>
+	struct is_error_code_enum<serialization::stream_errc> : true_type
+	{
+	};
+} // std
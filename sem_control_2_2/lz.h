@@ -0,0 +1,194 @@
+#pragma once 
+#include <vector>
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+
+namespace serialization
+{
+	// In-tree LZ77 block codec with an LZ4-like layout. A block is a series of sequences:
+	//   token        - high nibble: literal count, low nibble: match length - min_match
+	//                  (15 in a nibble means more length bytes follow: 255, 255, ..., rest)
+	//   literals
+	//   offset       - 2 bytes, little endian, distance back to the match
+	//   match length bytes, if any
+	// The last sequence has literals only and ends the block.
+	namespace lz
+	{
+		const size_t min_match	= 4;
+		const size_t max_offset	= 65535;
+		const size_t hash_bits	= 14;
+
+		inline size_t max_compressed_size(size_t size)
+		{
+			return size + size / 255 + 16;
+		}
+
+		// most bytes `size` compressed bytes can expand to: a match length byte is worth 255
+		inline size_t max_decompressed_size(size_t size)
+		{
+			return size * 255;
+		}
+
+		namespace details
+		{
+			inline uint32_t read32(const char* p)
+			{
+				uint32_t value;
+				memcpy(&value, p, sizeof(value));
+				return value;
+			}
+
+			inline uint32_t hash(uint32_t sequence)
+			{
+				return (sequence * 2654435761u) >> (32 - hash_bits);
+			}
+
+			inline char* write_length(char* out, size_t length)
+			{
+				for (; length >= 255; length -= 255)
+					*out++ = static_cast<char>(255);
+				*out++ = static_cast<char>(length);
+				return out;
+			}
+
+			inline char* write_sequence(char* out, const char* literals, size_t literal_count,
+			                            size_t offset, size_t match_length)
+			{
+				char* token = out++;
+				*token = static_cast<char>((literal_count < 15 ? literal_count : 15) << 4);
+				if (literal_count >= 15)
+					out = write_length(out, literal_count - 15);
+
+				memcpy(out, literals, literal_count);
+				out += literal_count;
+
+				if (match_length == 0)
+					return out;
+
+				*out++ = static_cast<char>(offset & 0xff);
+				*out++ = static_cast<char>(offset >> 8);
+
+				size_t length = match_length - min_match;
+				*token |= static_cast<char>(length < 15 ? length : 15);
+				if (length >= 15)
+					out = write_length(out, length - 15);
+				return out;
+			}
+
+			// false on a malformed length
+			inline bool read_length(const char*& p, const char* end, size_t& length)
+			{
+				for (;;)
+				{
+					if (p == end)
+						return false;
+					unsigned char byte = static_cast<unsigned char>(*p++);
+					length += byte;
+					if (byte != 255)
+						return true;
+				}
+			}
+		} // details
+
+		// match finder state, reusable across calls to compress() so each block doesn't allocate one
+		typedef std::vector<uint32_t> hash_table;
+
+		// out must have room for max_compressed_size(size) bytes, returns the compressed size
+		inline size_t compress(const char* in, size_t size, char* out, hash_table& table)
+		{
+			table.assign(size_t(1) << hash_bits, 0); // position + 1, 0 is empty
+
+			char* begin = out;
+			size_t anchor = 0;
+			size_t pos = 0;
+			size_t misses = 0;
+
+			while (pos + min_match <= size)
+			{
+				uint32_t sequence = details::read32(in + pos);
+				uint32_t& slot = table[details::hash(sequence)];
+				size_t candidate = slot;
+				slot = static_cast<uint32_t>(pos + 1);
+
+				if (candidate == 0 || pos - (candidate - 1) > max_offset
+				    || details::read32(in + candidate - 1) != sequence)
+				{
+					// skip faster through data that doesn't compress
+					pos += 1 + (misses++ >> 6);
+					continue;
+				}
+
+				size_t match = candidate - 1;
+				size_t length = min_match;
+				while (pos + length < size && in[match + length] == in[pos + length])
+					++length;
+
+				out = details::write_sequence(out, in + anchor, pos - anchor, pos - match, length);
+				pos += length;
+				anchor = pos;
+				misses = 0;
+			}
+
+			out = details::write_sequence(out, in + anchor, size - anchor, 0, 0);
+			return out - begin;
+		}
+
+		inline size_t compress(const char* in, size_t size, char* out)
+		{
+			hash_table table;
+			return compress(in, size, out, table);
+		}
+
+		// decompresses exactly out_size bytes, false if the input is malformed
+		inline bool decompress(const char* in, size_t size, char* out, size_t out_size)
+		{
+			const char* end = in + size;
+			char* begin = out;
+			char* out_end = out + out_size;
+
+			while (in != end)
+			{
+				unsigned char token = static_cast<unsigned char>(*in++);
+
+				size_t literal_count = token >> 4;
+				if (literal_count == 15 && !details::read_length(in, end, literal_count))
+					return false;
+				if (literal_count > static_cast<size_t>(end - in) || literal_count > static_cast<size_t>(out_end - out))
+					return false;
+
+				memcpy(out, in, literal_count);
+				in += literal_count;
+				out += literal_count;
+
+				if (in == end)
+					break;
+
+				if (end - in < 2)
+					return false;
+				size_t offset = static_cast<unsigned char>(in[0]) | (static_cast<unsigned char>(in[1]) << 8);
+				in += 2;
+
+				size_t length = token & 0x0f;
+				if (length == 15 && !details::read_length(in, end, length))
+					return false;
+				length += min_match;
+
+				if (offset == 0 || offset > static_cast<size_t>(out - begin) || length > static_cast<size_t>(out_end - out))
+					return false;
+
+				const char* match = out - offset;
+				if (offset >= length)
+					memcpy(out, match, length);
+				else
+				{
+					// overlapping match repeats the last `offset` bytes, copy byte by byte
+					for (size_t i = 0; i < length; ++i)
+						out[i] = match[i];
+				}
+				out += length;
+			}
+			return out == out_end;
+		}
+	} // lz
+} // serialization
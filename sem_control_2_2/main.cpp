@@ -1,7 +1,29 @@
 #include <type_traits>
 #include <cstdlib>
+#include <vector>
+#include <array>
+#include <string>
+#include <limits>
+#include <cstring>
+#include <atomic>
+#include <stdexcept>
+#include <unistd.h>
 
+#include "alloc_count.h"
+#include "arena_dict.h"
+#include "buffer_pool.h"
+#include "checksummed_blocks.h"
+#include "columns.h"
+#include "compressed_blocks.h"
+#include "delta.h"
 #include "dict.h"
+#include "dict_json.h"
+#include "fd_sink.h"
+#include "flat_dict.h"
+#include "framed.h"
+#include "parallel.h"
+#include "record_view.h"
+#include "tagged.h"
 #include "task.h"
 
 //using namespace std;
@@ -16,6 +38,14 @@ struct pod_struct
     double b;
 };
 
+// optional for PODs: without it pod_struct is written as its raw bytes, padding included
+template <class visitor_t>
+void reflect(const visitor_t& visitor, pod_struct& ps)
+{
+    visitor(ps.a, "a");
+    visitor(ps.b, "b");
+}
+
 void test_stream_pod()
 {
     static_assert(is_pod<pod_struct>::value, "pod_struct not pod!?");
@@ -27,6 +57,26 @@ void test_stream_pod()
     serialization::read(is, ps_read);
     assert(ps.a == ps_read.a);
     assert(ps.b == ps_read.b);
+
+    // no padding, little endian fields: the bytes only depend on the values
+    assert(os.size() == sizeof(int) + sizeof(double));
+    assert(os.data()[0] == 1 && os.data()[1] == 0);
+
+    pod_struct garbage;
+    memset(&garbage, 0xAB, sizeof(garbage));
+    garbage.a = ps.a;
+    garbage.b = ps.b;
+    serialization::output_stream garbage_os;
+    serialization::write(garbage_os, garbage);
+    assert(garbage_os.data() == os.data());
+
+    // streams take plain byte vectors
+    std::vector<char> bytes(os.data().begin(), os.data().end());
+    serialization::input_stream bytes_is(bytes);
+    serialization::read(bytes_is, ps_read);
+    assert(ps_read.a == ps.a);
+    std::vector<char> detached = garbage_os.detach();
+    assert(detached == bytes);
 }
 
 struct not_pod_struct
@@ -80,10 +130,196 @@ void test_stream_not_pod()
     assert(ps.get_c() == ps_read.get_c());
 }
 
-void test_stream_serialization()
+struct container_record
 {
-    test_stream_pod();
-    test_stream_not_pod();
+    std::vector<float>          floats;
+    std::vector<int64_t>        ints;
+    std::string                 name;
+    std::array<int, 3>          triple;
+    std::vector<not_pod_struct> items;
+};
+
+template<class visitor_t>
+void reflect(const visitor_t& visitor, container_record& r)
+{
+    visitor(r.floats, "floats");
+    visitor(r.ints, "ints");
+    visitor(r.name, "name");
+    visitor(r.triple, "triple");
+    visitor(r.items, "items");
+}
+
+void test_stream_containers()
+{
+    container_record cr;
+    cr.floats = { 1.5f, 2.5f, 3.5f };
+    cr.ints = { -1, 1ll << 40 };
+    cr.name = "record";
+    cr.triple = {{ 7, 8, 9 }};
+    cr.items = { not_pod_struct(1, 3.14, 'P'), not_pod_struct(2, 2.71, 'Q') };
+
+    serialization::output_stream os;
+    serialization::write(os, cr);
+    assert(os.size() == serialization::measure(cr));
+
+    serialization::output_stream items, items_one_by_one;
+    serialization::write(items, cr.items);
+    serialization::write(items_one_by_one, static_cast<serialization::size_type>(cr.items.size()));
+    for (not_pod_struct const& item : cr.items)
+        serialization::write(items_one_by_one, item);
+    assert(items.data() == items_one_by_one.data());
+
+    serialization::input_stream is(os.data());
+    container_record cr_read;
+    serialization::read(is, cr_read);
+    assert(is.remaining() == 0);
+    assert(cr_read.floats == cr.floats);
+    assert(cr_read.ints == cr.ints);
+    assert(cr_read.name == cr.name);
+    assert(cr_read.triple == cr.triple);
+    assert(cr_read.items.size() == 2);
+    assert(cr_read.items[1].get_c() == 'Q');
+
+    serialization::bytes_t bytes = os.detach();
+    std::error_code ec;
+    for (size_t size = 0; size < bytes.size(); ++size)
+    {
+        serialization::input_stream truncated(bytes.data(), size);
+        serialization::read(truncated, cr_read, ec);
+        assert(ec == serialization::stream_errc::truncated);
+    }
+
+    serialization::input_stream whole(bytes);
+    serialization::read(whole, cr_read, ec);
+    assert(!ec);
+    assert(cr_read.name == cr.name);
+
+    // std::vector<bool> has no contiguous storage, its elements go one by one
+    std::vector<bool> flags = { true, false, true, true };
+    serialization::output_stream flags_os;
+    serialization::write(flags_os, flags);
+    assert(flags_os.size() == serialization::measure(flags));
+
+    serialization::input_stream flags_is(flags_os.data());
+    std::vector<bool> flags_read;
+    serialization::read(flags_is, flags_read);
+    assert(flags_read == flags);
+
+    serialization::input_stream flags_checked(flags_os.data().data(), flags_os.size() - 1);
+    serialization::read(flags_checked, flags_read, ec);
+    assert(ec == serialization::stream_errc::truncated);
+}
+
+void test_stream_compact()
+{
+    container_record cr;
+    cr.ints = { 0, -1, 1, 300, -300, INT64_MAX, INT64_MIN };
+    cr.name = "compact";
+    cr.items = { not_pod_struct(-5, 3.14, 'P') };
+    for (int i = -100; i < 100; ++i)
+        cr.ints.push_back(i);
+
+    serialization::compact_output_stream os;
+    serialization::write(os, cr);
+
+    serialization::output_stream fixed;
+    serialization::write(fixed, cr);
+    assert(os.size() < fixed.size());
+
+    serialization::compact_input_stream is(os.data());
+    container_record cr_read;
+    serialization::read(is, cr_read);
+    assert(is.remaining() == 0);
+    assert(cr_read.ints == cr.ints);
+    assert(cr_read.name == cr.name);
+    assert(cr_read.items[0].a == -5);
+
+    std::error_code ec;
+    for (size_t size = 0; size < os.size(); ++size)
+    {
+        serialization::compact_input_stream truncated(os.data().data(), size);
+        serialization::read(truncated, cr_read, ec);
+        assert(ec == serialization::stream_errc::truncated);
+    }
+}
+
+void test_stream_truncated()
+{
+    not_pod_struct ps{ 1, 3.14, 'P' };
+    serialization::output_stream os;
+    serialization::write(os, ps);
+
+    serialization::bytes_t truncated = os.detach();
+    truncated.pop_back();
+
+    std::error_code ec;
+    serialization::input_stream is(truncated);
+    not_pod_struct ps_read;
+    serialization::read(is, ps_read, ec);
+    assert(ec == serialization::stream_errc::truncated);
+    assert(is.remaining() == truncated.size());
+
+    truncated.push_back('P');
+    serialization::input_stream is_restored(truncated);
+    serialization::read(is_restored, ps_read, ec);
+    assert(!ec);
+    assert(ps_read.get_c() == 'P');
+}
+
+void test_stream_sink()
+{
+    not_pod_struct ps{ 1, 3.14, 'P' };
+    serialization::output_stream expected;
+    serialization::bytes_t streamed;
+    size_t chunks = 0;
+    {
+        serialization::output_stream os([&](const char* data, size_t size)
+        {
+            assert(size <= 16);
+            streamed.insert(streamed.end(), data, data + size);
+            ++chunks;
+        }, 16);
+
+        for (int i = 0; i < 10; ++i)
+        {
+            serialization::write(os, ps);
+            serialization::write(expected, ps);
+        }
+
+        size_t capacity = os.capacity();
+        os.shrink_to_fit();
+        assert(os.capacity() == capacity);
+    }
+    assert(streamed == expected.data());
+    assert(chunks > 1);
+}
+
+void test_stream_mapped_file()
+{
+    not_pod_struct ps{ 1, 3.14, 'P' };
+
+    char path[] = "/tmp/sem_control_2_2_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    {
+        serialization::output_stream os(serialization::fd_sink(fd), 8);
+        serialization::write(os, ps);
+        serialization::write(os, ps);
+        os.flush();
+    }
+    close(fd);
+
+    {
+        serialization::mapped_file file(path);
+        serialization::input_stream is(file);
+        not_pod_struct ps_read;
+        serialization::read(is, ps_read);
+        serialization::read(is, ps_read);
+        assert(ps.a == ps_read.a);
+        assert(ps.get_c() == ps_read.get_c());
+        assert(is.remaining() == 0);
+    }
+    unlink(path);
 }
 
 
@@ -133,6 +369,774 @@ void reflect(const visitor_t& visitor, custom_record& cr)
     visitor(cr.small, "small");
 }
 
+void test_stream_compiled_schema()
+{
+    // dvalue, ivalue, small.letter and small.flag are adjacent in memory: a single memcpy
+    auto runs = serialization::details::compiled_schema<custom_record, serialization::fixed_width_encoding>();
+    assert(runs && runs->size() == 1);
+    assert(!(serialization::details::compiled_schema<custom_record, serialization::compact_encoding>()));
+
+    custom_record cr;
+    cr.dvalue = 3.14;
+    cr.ivalue = 42;
+    cr.small.letter = 'P';
+    cr.small.flag = true;
+
+    serialization::output_stream os;
+    serialization::write(os, cr);
+    assert(os.size() == sizeof(double) + sizeof(int) + sizeof(char) + sizeof(bool));
+
+    serialization::input_stream is(os.data());
+    custom_record cr_read;
+    serialization::read(is, cr_read);
+    assert(cr_read.dvalue == cr.dvalue);
+    assert(cr_read.ivalue == cr.ivalue);
+    assert(cr_read.small.letter == 'P');
+    assert(cr_read.small.flag);
+}
+
+// no default constructor: written, measured and read through the plain reflect() walk
+struct fixed_id_record
+{
+    explicit fixed_id_record(int id)
+        : id(id)
+        , score(0)
+    {
+    }
+
+    int    id;
+    double score;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, fixed_id_record& fr)
+{
+    visitor(fr.id, "id");
+    visitor(fr.score, "score");
+}
+
+void test_stream_not_default_constructible()
+{
+    fixed_id_record record(7);
+    record.score = 0.5;
+
+    serialization::output_stream os;
+    serialization::write(os, record);
+    assert(serialization::measure(record) == os.size());
+    assert((serialization::serialized_size<fixed_id_record, serialization::fixed_width_encoding>() == 0));
+
+    serialization::input_stream is(os.data());
+    fixed_id_record record_read(0);
+    std::error_code ec;
+    serialization::read(is, record_read, ec);
+    assert(!ec && record_read.id == 7 && record_read.score == 0.5);
+
+    serialization::output_stream tagged_os;
+    serialization::write_tagged(tagged_os, record);
+    serialization::input_stream tagged_is(tagged_os.data());
+    fixed_id_record tagged_read(0);
+    assert(serialization::read_tagged(tagged_is, tagged_read));
+    assert(tagged_read.id == 7 && tagged_read.score == 0.5);
+
+    serialization::output_stream columns_os;
+    serialization::write_columns(columns_os, std::vector<fixed_id_record>(2, record));
+    serialization::input_stream columns_is(columns_os.data());
+    std::vector<double> scores;
+    assert(serialization::read_column(columns_is, "score", scores));
+    assert(scores.size() == 2 && scores[1] == 0.5);
+}
+
+// custom_record with a column added, compiled_schema() still flattens it
+struct extended_record
+{
+    double          dvalue = 0;
+    int             ivalue = 0;
+    small_record    small;
+    short           added = -1;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, extended_record& er)
+{
+    visitor(er.dvalue, "dvalue");
+    visitor(er.ivalue, "ivalue");
+    visitor(er.small, "small");
+    visitor(er.added, "added");
+}
+
+// not compilable, columns are read field by field
+struct labelled_record
+{
+    std::string label = "none";
+    int         ivalue = 0;
+    double      dvalue = 2.5;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, labelled_record& lr)
+{
+    visitor(lr.label, "label");
+    visitor(lr.ivalue, "ivalue");
+    visitor(lr.dvalue, "dvalue");
+}
+
+struct wide_ivalue_record
+{
+    int64_t ivalue = 0;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, wide_ivalue_record& wr)
+{
+    visitor(wr.ivalue, "ivalue");
+}
+
+void test_stream_columns_versioning()
+{
+    std::vector<custom_record> records(2);
+    records[1].ivalue = 7;
+    records[1].small.letter = 'x';
+
+    serialization::output_stream os;
+    serialization::write_columns(os, records);
+
+    // added column: the member initializer, on both paths
+    serialization::input_stream extended_is(os.data());
+    std::vector<extended_record> extended;
+    assert(serialization::read_columns(extended_is, extended));
+    assert(extended.size() == 2);
+    assert(extended[1].ivalue == 7 && extended[1].small.letter == 'x');
+    assert(extended[0].added == -1 && extended[1].added == -1);
+
+    serialization::input_stream labelled_is(os.data());
+    std::vector<labelled_record> labelled(1);
+    labelled[0].label = "stale";
+    assert(serialization::read_columns(labelled_is, labelled));
+    assert(labelled.size() == 2);
+    assert(labelled[0].label == "none" && labelled[1].label == "none");
+    assert(labelled[1].ivalue == 7 && labelled[1].dvalue == 0);
+
+    // removed column: skipped
+    serialization::output_stream extended_os;
+    serialization::write_columns(extended_os, extended);
+    serialization::write(extended_os, 42);
+
+    serialization::input_stream removed_is(extended_os.data());
+    std::vector<custom_record> removed;
+    assert(serialization::read_columns(removed_is, removed));
+    assert(removed.size() == 2 && removed[1].ivalue == 7);
+    int tail;
+    serialization::read(removed_is, tail);
+    assert(tail == 42);
+}
+
+void test_stream_columns_compact()
+{
+    std::vector<labelled_record> records(3);
+    for (int i = 0; i < 3; ++i)
+    {
+        records[i].label = std::string(i, 'l');
+        records[i].ivalue = -i * 1000;
+    }
+
+    serialization::compact_output_stream os;
+    serialization::write_columns(os, records);
+
+    serialization::compact_input_stream is(os.data());
+    std::vector<labelled_record> records_read;
+    assert(serialization::read_columns(is, records_read));
+    assert(records_read.size() == 3);
+    assert(records_read[2].label == "ll" && records_read[2].ivalue == -2000 && records_read[2].dvalue == 2.5);
+    assert(is.remaining() == 0);
+
+    serialization::compact_input_stream column_is(os.data());
+    std::vector<int> ivalues;
+    assert(serialization::read_column(column_is, "ivalue", ivalues));
+    assert((ivalues == std::vector<int>{ 0, -1000, -2000 }));
+}
+
+void test_stream_columns_malformed()
+{
+    // a column whose size doesn't match the field
+    std::vector<wide_ivalue_record> wide(4);
+    serialization::output_stream wide_os;
+    serialization::write_columns(wide_os, wide);
+
+    serialization::input_stream wide_is(wide_os.data());
+    std::vector<custom_record> records;
+    assert(!serialization::read_columns(wide_is, records));
+
+    serialization::input_stream wide_column_is(wide_os.data());
+    std::vector<int> ivalues;
+    assert(!serialization::read_column(wide_column_is, "ivalue", ivalues));
+    assert(ivalues.empty());
+
+    // truncated batches, on both paths
+    std::vector<labelled_record> labelled(4);
+    serialization::output_stream labelled_os;
+    serialization::write_columns(labelled_os, labelled);
+    serialization::bytes_t truncated = labelled_os.data();
+    truncated.pop_back();
+
+    serialization::input_stream labelled_is(truncated);
+    std::vector<labelled_record> labelled_read;
+    assert(!serialization::read_columns(labelled_is, labelled_read));
+
+    serialization::output_stream custom_os;
+    serialization::write_columns(custom_os, std::vector<custom_record>(4));
+    for (size_t size = 0; size < custom_os.size(); ++size)
+    {
+        serialization::input_stream custom_is(custom_os.data().data(), size);
+        assert(!serialization::read_columns(custom_is, records));
+    }
+
+    // record counts the batch can't hold: with an unmatched column, and one whose size
+    // times the record count wraps around to the column size
+    const uint64_t counts[] = { uint64_t(1) << 40, (uint64_t(1) << 61) + 1 };
+    const char* names[] = { "unknown", "dvalue" };
+    for (size_t i = 0; i < 2; ++i)
+    {
+        serialization::output_stream forged_os;
+        serialization::write(forged_os, counts[i]);
+        serialization::write(forged_os, uint64_t(1));
+        serialization::write(forged_os, std::string(names[i]));
+        serialization::write(forged_os, uint64_t(sizeof(double)));
+        serialization::write(forged_os, 1.0);
+
+        serialization::input_stream forged_is(forged_os.data());
+        assert(!serialization::read_columns(forged_is, records));
+    }
+    assert(!serialization::details::column_fits(sizeof(double), (size_t(1) << 61) + 1, sizeof(double)));
+}
+
+void test_stream_columns()
+{
+    std::vector<custom_record> records(3);
+    for (int i = 0; i < 3; ++i)
+    {
+        records[i].dvalue = i * 0.5;
+        records[i].ivalue = i * 10;
+        records[i].small.letter = static_cast<char>('a' + i);
+        records[i].small.flag = i % 2 == 1;
+    }
+
+    serialization::output_stream os;
+    serialization::write_columns(os, records);
+    serialization::write(os, 42);
+
+    serialization::input_stream is(os.data());
+    std::vector<custom_record> records_read;
+    assert(serialization::read_columns(is, records_read));
+    assert(records_read.size() == 3);
+    assert(records_read[2].dvalue == 1.0);
+    assert(records_read[2].ivalue == 20);
+    assert(records_read[2].small.letter == 'c');
+    assert(records_read[1].small.flag);
+
+    int tail;
+    serialization::read(is, tail);
+    assert(tail == 42);
+
+    serialization::input_stream column_is(os.data());
+    std::vector<int> ivalues;
+    assert(serialization::read_column(column_is, "ivalue", ivalues));
+    assert((ivalues == std::vector<int>{ 0, 10, 20 }));
+    serialization::read(column_is, tail);
+    assert(tail == 42);
+
+    serialization::input_stream small_is(os.data());
+    std::vector<small_record> smalls;
+    assert(serialization::read_column(small_is, "small", smalls));
+    assert(smalls[1].letter == 'b');
+
+    serialization::input_stream missing_is(os.data());
+    std::vector<double> missing;
+    assert(!serialization::read_column(missing_is, "missing", missing));
+
+    test_stream_columns_versioning();
+    test_stream_columns_compact();
+    test_stream_columns_malformed();
+}
+
+void test_stream_parallel()
+{
+    std::vector<custom_record> records(1000);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        records[i].dvalue = i * 0.5;
+        records[i].ivalue = static_cast<int>(i);
+        records[i].small.letter = static_cast<char>('a' + i % 26);
+    }
+
+    for (size_t threads : { 1, 4 })
+    {
+        serialization::output_stream os;
+        serialization::write_parallel(os, records, threads);
+        serialization::write(os, 42);
+
+        serialization::input_stream is(os.data());
+        std::vector<custom_record> records_read;
+        serialization::read_parallel(is, records_read, 3);
+        assert(records_read.size() == records.size());
+        assert(records_read[999].ivalue == 999);
+        assert(records_read[999].dvalue == 499.5);
+        assert(records_read[27].small.letter == 'b');
+
+        int tail;
+        serialization::read(is, tail);
+        assert(tail == 42);
+    }
+
+    // truncated batches and forged shard counts, sizes and record counts are reported
+    serialization::output_stream batch_os;
+    serialization::write_parallel(batch_os, records, 4);
+    std::vector<custom_record> records_read;
+    std::error_code ec;
+    for (size_t size : { size_t(0), size_t(8), size_t(40), batch_os.size() - 1 })
+    {
+        serialization::input_stream is(batch_os.data().data(), size);
+        serialization::read_parallel(is, records_read, 2, ec);
+        assert(ec == serialization::stream_errc::truncated);
+    }
+
+    const uint64_t huge = uint64_t(1) << 62;
+    const uint64_t forged[][5] = {
+        { huge, 0, 0, 0, 0 },               // shards
+        { 2, huge, 16, huge, 16 },          // record counts summing past 2^64
+        { 2, 1, huge * 3, 1, huge * 3 },    // sizes summing past 2^64
+        { 1, huge, 16, 0, 0 },              // more records than bytes
+    };
+    for (auto const& header : forged)
+    {
+        serialization::output_stream forged_os;
+        for (uint64_t value : header)
+            serialization::write(forged_os, value);
+        serialization::input_stream is(forged_os.data());
+        serialization::read_parallel(is, records_read, 2, ec);
+        assert(ec);
+    }
+
+    bool thrown_truncated = false;
+    try
+    {
+        serialization::input_stream is(batch_os.data().data(), 40);
+        serialization::read_parallel(is, records_read, 2);
+    }
+    catch (std::system_error const&)
+    {
+        thrown_truncated = true;
+    }
+    assert(thrown_truncated);
+
+    // an exception thrown by a task, on a worker or on the calling thread, reaches the caller
+    for (size_t failing : { 0, 5 })
+    {
+        std::atomic<size_t> done(0);
+        bool thrown = false;
+        try
+        {
+            serialization::details::parallel_for(16, 4, [&](size_t task)
+            {
+                if (task == failing)
+                    throw std::runtime_error("task failed");
+                ++done;
+            });
+        }
+        catch (std::runtime_error const&)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(done < 16);
+    }
+}
+
+void test_stream_framed()
+{
+    serialization::output_stream os;
+    serialization::framed_writer writer(os);
+    for (int i = 0; i < 100; ++i)
+    {
+        container_record cr;
+        cr.ints.assign(i, i);
+        cr.name = std::to_string(i);
+        writer.append(cr);
+    }
+    writer.finish();
+
+    serialization::framed_reader reader(os.data());
+    assert(reader.valid());
+    assert(reader.size() == 100);
+
+    container_record cr;
+    assert(reader.read_record(42, cr));
+    assert(cr.name == "42");
+    assert(cr.ints.size() == 42);
+
+    int visited = 0;
+    assert(reader.for_each<container_record>(10, 20, [&visited](size_t k, container_record const& cr)
+    {
+        assert(cr.name == std::to_string(k));
+        ++visited;
+    }));
+    assert(visited == 10);
+
+    // the index and trailer are little endian whatever the host
+    serialization::bytes_t bytes = os.data();
+    size_t trailer = bytes.size() - 2 * sizeof(uint64_t);
+    size_t index = trailer - 100 * sizeof(uint64_t);
+    uint64_t count;
+    memcpy(&count, &bytes[trailer], sizeof(count));
+    assert(serialization::to_wire_order(count) == 100);
+
+    // truncated containers and a trailer pointing past the end
+    for (size_t size : { size_t(0), size_t(15), bytes.size() - 1 })
+        assert(!serialization::framed_reader(bytes.data(), size).valid());
+
+    serialization::bytes_t bad_trailer = bytes;
+    uint64_t index_offset = serialization::to_wire_order(uint64_t(bytes.size()));
+    memcpy(&bad_trailer[trailer + sizeof(count)], &index_offset, sizeof(index_offset));
+    serialization::framed_reader bad_reader(bad_trailer);
+    assert(!bad_reader.valid() && bad_reader.size() == 0);
+
+    // a record offset in the index pointing past the records, and a payload size running past them
+    serialization::bytes_t bad_index = bytes;
+    uint64_t offset = serialization::to_wire_order(uint64_t(bytes.size()));
+    memcpy(&bad_index[index + 42 * sizeof(uint64_t)], &offset, sizeof(offset));
+    serialization::framed_reader bad_index_reader(bad_index);
+    assert(bad_index_reader.valid());
+    assert(!bad_index_reader.read_record(42, cr));
+    assert(bad_index_reader.read_record(41, cr));
+
+    serialization::bytes_t bad_size = bytes;
+    uint64_t last_offset;
+    memcpy(&last_offset, &bytes[index + 99 * sizeof(uint64_t)], sizeof(last_offset));
+    serialization::size_type payload_size = serialization::to_wire_order(serialization::size_type(1) << 40);
+    memcpy(&bad_size[serialization::to_wire_order(last_offset)], &payload_size, sizeof(payload_size));
+    assert(!serialization::framed_reader(bad_size).read_record(99, cr));
+    assert(!serialization::framed_reader(bad_size).for_each<container_record>(0, 100, [](size_t, container_record const&){}));
+}
+
+void test_stream_view()
+{
+    custom_record cr;
+    cr.dvalue = 2.5;
+    cr.ivalue = 42;
+    cr.small.letter = 'V';
+    cr.small.flag = true;
+
+    serialization::output_stream os;
+    serialization::write(os, cr);
+
+    serialization::record_view<custom_record> view(serialization::input_stream(os.data()));
+    assert(view.get(&custom_record::ivalue) == 42);
+    assert(view.get(&custom_record::dvalue) == 2.5);
+    assert(view.field_view(&custom_record::small).get(&small_record::letter) == 'V');
+    assert(view.size() == os.size());
+
+    // fields after variable-size ones are found by skipping, in any order
+    container_record cnt;
+    cnt.floats = { 1.5f, 2.5f };
+    cnt.ints = { -1, 1ll << 40, 3 };
+    cnt.name = "view";
+    cnt.triple = {{ 7, 8, 9 }};
+    cnt.items = { not_pod_struct(1, 3.14, 'P') };
+
+    for (int compact = 0; compact < 2; ++compact)
+    {
+        serialization::output_stream fixed_os;
+        serialization::compact_output_stream compact_os;
+        serialization::write(fixed_os, cnt);
+        serialization::write(compact_os, cnt);
+        serialization::write(fixed_os, 17);
+        serialization::write(compact_os, 17);
+
+        auto check = [&cnt](auto const& cnt_view, size_t record_size)
+        {
+            assert(cnt_view.get(&container_record::name) == "view");
+            assert(cnt_view.get(&container_record::ints) == cnt.ints);
+            assert(cnt_view.get(&container_record::triple)[2] == 9);
+            assert(cnt_view.get(&container_record::items)[0].get_c() == 'P');
+            assert(cnt_view.get(&container_record::floats) == cnt.floats);
+            assert(cnt_view.size() == record_size);
+        };
+
+        if (compact)
+            check(serialization::compact_record_view<container_record>(compact_os.data().data(), compact_os.size()),
+                  compact_os.size() - 1);
+        else
+            check(serialization::record_view<container_record>(fixed_os.data().data(), fixed_os.size()),
+                  fixed_os.size() - sizeof(int));
+    }
+}
+
+void test_stream_compressed()
+{
+    serialization::bytes_t compressed;
+    {
+        serialization::output_stream os(serialization::compressing_sink([&compressed](const char* data, size_t size)
+        {
+            compressed.insert(compressed.end(), data, data + size);
+        }, 1000), 1000);
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            container_record cr;
+            cr.ints.assign(i % 10, i);
+            cr.name = "record " + std::to_string(i);
+            serialization::write(os, cr);
+        }
+        os.flush();
+    }
+
+    serialization::bytes_t raw;
+    assert(serialization::decompress_blocks(compressed.data(), compressed.size(), raw, 4));
+    assert(compressed.size() < raw.size());
+
+    serialization::input_stream is(raw);
+    for (int i = 0; i < 1000; ++i)
+    {
+        container_record cr;
+        serialization::read(is, cr);
+        assert(cr.name == "record " + std::to_string(i));
+        assert(cr.ints.size() == size_t(i % 10));
+    }
+    assert(is.remaining() == 0);
+
+    // incompressible block is stored as is
+    serialization::bytes_t noise(5000), noise_compressed;
+    for (size_t i = 0; i < noise.size(); ++i)
+        noise[i] = static_cast<char>((i * 2654435761u) >> 13);
+    serialization::compressing_sink sink([&noise_compressed](const char* data, size_t size)
+    {
+        noise_compressed.insert(noise_compressed.end(), data, data + size);
+    });
+    sink(noise.data(), noise.size());
+
+    serialization::bytes_t noise_raw;
+    assert(serialization::decompress_blocks(noise_compressed.data(), noise_compressed.size(), noise_raw));
+    assert(noise_raw == noise);
+
+    noise_compressed.pop_back();
+    assert(!serialization::decompress_blocks(noise_compressed.data(), noise_compressed.size(), noise_raw));
+
+    // a zero block size is clamped to one byte blocks rather than looping forever
+    serialization::bytes_t tiny_compressed;
+    serialization::compressing_sink tiny_sink([&tiny_compressed](const char* data, size_t size)
+    {
+        tiny_compressed.insert(tiny_compressed.end(), data, data + size);
+    }, 0);
+    tiny_sink("abc", 3);
+    assert(tiny_compressed.size() == 3 * (8 + 1));
+    assert(serialization::decompress_blocks(tiny_compressed.data(), tiny_compressed.size(), noise_raw, 1, 1));
+    assert(noise_raw == serialization::bytes_t({ 'a', 'b', 'c' }));
+
+    // crafted headers are rejected before out is sized from them
+    uint32_t huge_blocks[16];
+    for (size_t i = 0; i < 16; i += 2)
+    {
+        huge_blocks[i] = 0xFFFFFFFF;
+        huge_blocks[i + 1] = 0;
+    }
+    assert(!serialization::decompress_blocks(reinterpret_cast<const char*>(huge_blocks), sizeof(huge_blocks), noise_raw));
+
+    // a block larger than the sink's, and one larger than its stored bytes can expand to
+    serialization::bytes_t oversized(8 + 2000, 'x');
+    uint32_t oversized_header[2] = { serialization::to_wire_order(2000u), serialization::to_wire_order(2000u) };
+    memcpy(oversized.data(), oversized_header, sizeof(oversized_header));
+    assert(serialization::decompress_blocks(oversized.data(), oversized.size(), noise_raw));
+    assert(!serialization::decompress_blocks(oversized.data(), oversized.size(), noise_raw, 1, 1000));
+
+    serialization::bytes_t expanding(8 + 1, 'x');
+    uint32_t expanding_header[2] = { serialization::to_wire_order(1000u), serialization::to_wire_order(1u) };
+    memcpy(expanding.data(), expanding_header, sizeof(expanding_header));
+    assert(!serialization::decompress_blocks(expanding.data(), expanding.size(), noise_raw));
+}
+
+void test_stream_checksummed()
+{
+    assert(serialization::crc32c("123456789", 9) == 0xe3069283);
+    assert(serialization::crc32c("56789", 5, serialization::crc32c("1234", 4)) == 0xe3069283);
+
+    // both implementations agree on every length and alignment
+    std::string text(100, 0);
+    for (size_t i = 0; i < text.size(); ++i)
+        text[i] = static_cast<char>(i * 37);
+    for (size_t offset = 0; offset < 8; ++offset)
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data()) + offset;
+        uint32_t table = ~serialization::details::crc32c_table(~0u, p, text.size() - offset);
+        assert(serialization::crc32c(p, text.size() - offset) == table);
+    }
+
+    serialization::bytes_t framed;
+    {
+        serialization::output_stream os(serialization::checksumming_sink([&framed](const char* data, size_t size)
+        {
+            framed.insert(framed.end(), data, data + size);
+        }, 1000), 1000);
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            container_record cr;
+            cr.name = "record " + std::to_string(i);
+            serialization::write(os, cr);
+        }
+        os.flush();
+    }
+
+    serialization::bytes_t raw;
+    assert(serialization::verify_blocks(framed.data(), framed.size(), raw, 4));
+
+    serialization::input_stream is(raw);
+    for (int i = 0; i < 1000; ++i)
+    {
+        container_record cr;
+        serialization::read(is, cr);
+        assert(cr.name == "record " + std::to_string(i));
+    }
+    assert(is.remaining() == 0);
+
+    // an in-memory buffer is framed as the stream would be
+    serialization::bytes_t memory_framed = serialization::frame_blocks(raw, 700);
+    assert(memory_framed.size() == raw.size() + (raw.size() + 699) / 700 * 8);
+    serialization::bytes_t raw_read;
+    assert(serialization::verify_blocks(memory_framed.data(), memory_framed.size(), raw_read, 4));
+    assert(raw_read == raw);
+    assert(serialization::frame_blocks(serialization::bytes_t()).empty());
+    assert(serialization::frame_blocks(serialization::bytes_t(3, 'x'), 0).size() == 3 * (8 + 1));
+
+    // a flipped bit or a cut block is caught
+    framed[framed.size() / 2] ^= 0x10;
+    assert(!serialization::verify_blocks(framed.data(), framed.size(), raw));
+    framed[framed.size() / 2] ^= 0x10;
+    framed.pop_back();
+    assert(!serialization::verify_blocks(framed.data(), framed.size(), raw));
+}
+
+void test_stream_pooled()
+{
+    container_record cr;
+    cr.ints.assign(100, 7);
+    cr.name = "pooled";
+
+    auto encode = [&cr]
+    {
+        serialization::pooled_output_stream os(256);
+        serialization::write(os, cr);
+        assert(os.size() == serialization::measure(cr));
+    };
+
+    // the first message grows a buffer, later ones reuse it
+    encode();
+    size_t before = instrumentation::allocation_count();
+    for (int i = 0; i < 100; ++i)
+        encode();
+    assert(instrumentation::allocation_count() == before);
+
+    // buffers come back into the class they can serve, the smallest fitting one is handed out
+    serialization::bytes_t small = serialization::buffer_pool::acquire(100);
+    assert(small.capacity() >= 100 && small.empty());
+    serialization::bytes_t large = serialization::buffer_pool::acquire(5000);
+    assert(large.capacity() >= 5000);
+    size_t pooled = serialization::buffer_pool::size();
+    serialization::buffer_pool::release(std::move(large));
+    serialization::buffer_pool::release(std::move(small));
+    assert(serialization::buffer_pool::size() == pooled + 2);
+    assert(serialization::buffer_pool::acquire(3000).capacity() >= 5000);
+    assert(serialization::buffer_pool::acquire(64).capacity() < 5000);
+
+    // a small request doesn't take a buffer more than two classes larger
+    serialization::buffer_pool::clear();
+    assert(serialization::buffer_pool::size() == 0);
+    serialization::bytes_t big;
+    big.reserve(64 * 1024);
+    serialization::buffer_pool::release(std::move(big));
+    assert(serialization::buffer_pool::acquire(64).capacity() < 64 * 1024);
+    assert(serialization::buffer_pool::size() == 1);
+    assert(serialization::buffer_pool::acquire(16 * 1024).capacity() >= 64 * 1024);
+    assert(serialization::buffer_pool::size() == 0);
+}
+
+// plain, with padding after c
+struct padded_pod
+{
+    char    c;
+    int32_t i;
+
+    bool operator==(padded_pod const& other) const
+    {
+        return c == other.c && i == other.i;
+    }
+};
+
+void test_stream_delta()
+{
+    custom_record baseline;
+    baseline.dvalue = 1.5;
+    baseline.ivalue = 7;
+    baseline.small.letter = 'a';
+
+    // unchanged: just the bitmap of the three fields
+    serialization::output_stream os;
+    serialization::write_delta(os, baseline, baseline);
+    assert(os.size() == 1);
+
+    // a nested change: outer bitmap, inner bitmap, the new letter
+    custom_record current = baseline;
+    current.small.letter = 'b';
+    os.clear();
+    serialization::write_delta(os, current, baseline);
+    assert(os.size() == 3);
+
+    custom_record synced = baseline;
+    serialization::input_stream is(os.data());
+    serialization::read_delta(is, synced);
+    assert(is.remaining() == 0);
+    assert(synced.small.letter == 'b');
+    assert(synced.dvalue == 1.5 && synced.ivalue == 7 && !synced.small.flag);
+
+    // containers change as a whole, unchanged ones aren't sent
+    container_record cr_base;
+    cr_base.ints = { 1, 2, 3 };
+    cr_base.name = "base";
+    cr_base.triple = {{ 1, 2, 3 }};
+    cr_base.items.resize(2);
+
+    container_record cr = cr_base;
+    cr.name = "changed";
+    cr.items[1] = not_pod_struct(0, 0, 'Q');
+    serialization::compact_output_stream compact;
+    serialization::write_delta(compact, cr, cr_base);
+
+    container_record cr_synced = cr_base;
+    serialization::compact_input_stream compact_is(compact.data());
+    serialization::read_delta(compact_is, cr_synced);
+    assert(compact_is.remaining() == 0);
+    assert(cr_synced.name == "changed");
+    assert(cr_synced.ints == cr_base.ints);
+    assert(cr_synced.items[1].get_c() == 'Q');
+
+    // padding doesn't count as a change: padded PODs compare with operator==, arrays of them
+    // element by element
+    std::array<padded_pod, 2> padded_a, padded_b;
+    memset(&padded_a, 0x00, sizeof(padded_a));
+    memset(&padded_b, 0xff, sizeof(padded_b));
+    for (auto* p : { &padded_a, &padded_b })
+        for (padded_pod& element : *p)
+        {
+            element.c = 'x';
+            element.i = 42;
+        }
+    assert(memcmp(&padded_a, &padded_b, sizeof(padded_a)) != 0);
+    assert(serialization::details::fields_equal(padded_a[0], padded_b[0]));
+    assert(serialization::details::fields_equal(padded_a, padded_b));
+    assert(serialization::details::fields_equal(std::vector<padded_pod>(padded_a.begin(), padded_a.end()),
+                                                std::vector<padded_pod>(padded_b.begin(), padded_b.end())));
+    assert(!serialization::details::fields_equal(0.0, -0.0));
+    assert(serialization::details::fields_equal(std::vector<bool>{ true, false }, std::vector<bool>{ true, false }));
+}
+
 void test_dict_arithmetic()
 {
     serialization::dict d;
@@ -147,6 +1151,33 @@ void test_dict_arithmetic()
 
 }
 
+template <class T>
+T dict_round_trip(T value)
+{
+    serialization::dict d;
+    write(d, value);
+    T result;
+    read(d, result);
+    return result;
+}
+
+void test_dict_scalars()
+{
+    assert(dict_round_trip(0.1) == 0.1);
+    assert(dict_round_trip(1e-300) == 1e-300);
+    assert(dict_round_trip(std::numeric_limits<double>::max()) == std::numeric_limits<double>::max());
+    assert(dict_round_trip(1.0f / 3) == 1.0f / 3);
+    assert(dict_round_trip(std::numeric_limits<int64_t>::min()) == std::numeric_limits<int64_t>::min());
+    assert(dict_round_trip(true));
+    assert(dict_round_trip(' ') == ' ');
+
+    serialization::dict d;
+    d.value = "garbage";
+    int i = 42;
+    read(d, i);
+    assert(i == 0);
+}
+
 void test_dict_struct()
 {
     serialization::dict d;
@@ -224,11 +1255,368 @@ void test_dict_versioning()
     test_dict_field_removed();
 }
 
+struct ver1_batch
+{
+    std::vector<ver1> items;
+    std::string       label;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, ver1_batch& b)
+{
+    visitor(b.items, "items");
+    visitor(b.label, "label");
+}
+
+struct ver0_batch
+{
+    int               count = 0;
+    std::vector<ver0> items;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, ver0_batch& b)
+{
+    visitor(b.count, "count");
+    visitor(b.items, "items");
+}
+
+struct duplicate_names_record
+{
+    int a = 0;
+    int b = 0;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, duplicate_names_record& r)
+{
+    visitor(r.a, "a");
+    visitor(r.b, "a");
+}
+
+void test_stream_tagged_malformed()
+{
+    serialization::output_stream os;
+    serialization::write_tagged(os, ver0{ 5, 6, 'c' });
+    serialization::bytes_t bytes = os.data();
+
+    ver0 v0;
+    for (size_t size = 0; size < bytes.size(); ++size)
+    {
+        serialization::input_stream truncated(bytes.data(), size);
+        assert(!serialization::read_tagged(truncated, v0));
+    }
+
+    // body size 2: a field header cut inside its id
+    const char cut_id[] = { 2, 'a', 'b' };
+    serialization::input_stream cut_id_is(cut_id, sizeof(cut_id));
+    assert(!serialization::read_tagged(cut_id_is, v0));
+
+    // payload size past the end of the body
+    uint32_t id = serialization::to_wire_order(serialization::field_name("a").hash());
+    char long_payload[6] = { 5 };
+    memcpy(long_payload + 1, &id, sizeof(id));
+    long_payload[5] = 100;
+    serialization::input_stream long_payload_is(long_payload, sizeof(long_payload));
+    assert(!serialization::read_tagged(long_payload_is, v0));
+
+    // payload too short for the field
+    char short_payload[7] = { 6 };
+    memcpy(short_payload + 1, &id, sizeof(id));
+    short_payload[5] = 1;
+    serialization::input_stream short_payload_is(short_payload, sizeof(short_payload));
+    assert(!serialization::read_tagged(short_payload_is, v0));
+
+    // field id collisions fail whatever the build mode
+    bool thrown = false;
+    try
+    {
+        serialization::output_stream duplicate_os;
+        serialization::write_tagged(duplicate_os, duplicate_names_record());
+    }
+    catch (std::logic_error const&)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// binary counterpart of the dict versioning tests
+void test_stream_tagged()
+{
+    serialization::output_stream os;
+    serialization::write_tagged(os, ver1{ 3, 4 });
+    serialization::write_tagged(os, ver0{ 5, 6, 'c' });
+    serialization::write(os, 42);
+
+    serialization::input_stream is(os.data());
+    auto v0 = ver0{ 1, 1, 'x' };
+    assert(serialization::read_tagged(is, v0));
+    assert(v0.a == 3);
+    assert(v0.b == 4);
+    assert(v0.c == 0);
+
+    auto v1 = ver1{ 1, 1 };
+    assert(serialization::read_tagged(is, v1));
+    assert(v1.a == 5);
+    assert(v1.b == 6);
+
+    int tail;
+    serialization::read(is, tail);
+    assert(tail == 42);
+
+    // nested records evolve too, also as elements of a sequence
+    ver1_batch batch1;
+    batch1.items = { ver1{ 1, 2 }, ver1{ 3, 4 } };
+    batch1.label = "batch";
+
+    serialization::compact_output_stream compact_os;
+    serialization::write_tagged(compact_os, batch1);
+
+    serialization::compact_input_stream compact_is(compact_os.data());
+    ver0_batch batch0;
+    batch0.count = 7;
+    assert(serialization::read_tagged(compact_is, batch0));
+    assert(compact_is.remaining() == 0);
+    assert(batch0.count == 0);
+    assert(batch0.items.size() == 2);
+    assert(batch0.items[1].a == 3);
+    assert(batch0.items[1].b == 4);
+
+    container_record cr;
+    cr.floats = { 1.5f };
+    cr.ints = { -1, 1ll << 40 };
+    cr.name = "tagged";
+    cr.triple = {{ 7, 8, 9 }};
+    cr.items = { not_pod_struct(1, 3.14, 'P') };
+
+    serialization::output_stream cr_os;
+    serialization::write_tagged(cr_os, cr);
+    serialization::input_stream cr_is(cr_os.data());
+    container_record cr_read;
+    assert(serialization::read_tagged(cr_is, cr_read));
+    assert(cr_read.ints == cr.ints);
+    assert(cr_read.name == "tagged");
+    assert(cr_read.triple[2] == 9);
+    assert(cr_read.items[0].get_c() == 'P');
+
+    test_stream_tagged_malformed();
+}
+
+void test_flat_dict()
+{
+    serialization::flat_dict d;
+
+    custom_record cr;
+    cr.dvalue = 3.14;
+    cr.ivalue = 42;
+    cr.small.letter = 'P';
+    cr.small.flag = true;
+    write(d.root(), cr);
+
+    custom_record cr2;
+    read(d.root(), cr2);
+    assert(abs(cr2.dvalue - 3.14) < 0.001);
+    assert(cr2.ivalue == 42);
+    assert(cr2.small.letter == 'P');
+    assert(cr2.small.flag);
+
+    serialization::flat_dict d1;
+    write(d1.root(), ver1{ 3, 4 });
+    auto v0 = ver0{ 1, 1, 'c' };
+    read(d1.root(), v0);
+    assert(v0.a == 3);
+    assert(v0.b == 4);
+    assert(v0.c == 0);
+}
+
+void test_arena_dict()
+{
+    const size_t records = 1000;
+
+    size_t before = instrumentation::allocation_count();
+    std::vector<serialization::dict> heap_dicts(records);
+    for (serialization::dict& d : heap_dicts)
+        write(d, custom_record());
+    size_t heap_allocations = instrumentation::allocation_count() - before;
+
+    serialization::dict_arena arena;
+    std::vector<serialization::arena_dict*> arena_dicts;
+    arena_dicts.reserve(records);
+
+    before = instrumentation::allocation_count();
+    for (size_t i = 0; i < records; ++i)
+    {
+        custom_record cr;
+        cr.ivalue = static_cast<int>(i);
+        cr.small.letter = 'P';
+        serialization::arena_dict& d = arena.create();
+        write(d, cr);
+        arena_dicts.push_back(&d);
+    }
+    size_t arena_allocations = instrumentation::allocation_count() - before;
+
+    // a handful of arena buffers for the whole batch, instead of one allocation per node
+    assert(heap_allocations >= records * 5);
+    assert(arena_allocations < records / 10);
+
+    custom_record cr;
+    read(*arena_dicts[42], cr);
+    assert(cr.ivalue == 42);
+    assert(cr.small.letter == 'P');
+
+    arena.release();
+    serialization::arena_dict& d = arena.create();
+    write(d, ver1{ 3, 4 });
+    auto v0 = ver0{ 1, 1, 'c' };
+    read(d, v0);
+    assert(v0.a == 3);
+    assert(v0.c == 0);
+}
+
+// names longer than std::string's inline buffer
+struct long_names_record
+{
+    int     first_field_with_a_long_name = 0;
+    double  second_field_with_a_long_name = 0;
+};
+
+template <class visitor_t>
+void reflect(const visitor_t& visitor, long_names_record& r)
+{
+    visitor(r.first_field_with_a_long_name, "first_field_with_a_long_name");
+    visitor(r.second_field_with_a_long_name, "second_field_with_a_long_name");
+}
+
+void test_dict_field_names()
+{
+    constexpr serialization::field_name name("ivalue");
+    static_assert(name.size() == 6, "literal size");
+    static_assert(name.hash() == serialization::field_name_hash("ivalue", 6), "hashed at compile time");
+    assert(serialization::field_name(std::string("ivalue")).hash() == name.hash());
+
+    long_names_record r;
+    r.first_field_with_a_long_name = 7;
+    r.second_field_with_a_long_name = 0.5;
+
+    serialization::dict d;
+    write(d, r);
+    serialization::flat_dict flat;
+    write(flat.root(), r);
+
+    // lookups take the names as they are, without building a std::string
+    long_names_record r2;
+    size_t before = instrumentation::allocation_count();
+    read(d, r2);
+    read(static_cast<serialization::flat_dict const&>(flat).root(), r2);
+    assert(instrumentation::allocation_count() == before);
+    assert(r2.first_field_with_a_long_name == 7);
+    assert(r2.second_field_with_a_long_name == 0.5);
+
+    serialization::flat_dict copy = flat;
+    flat = serialization::flat_dict();
+    long_names_record r3;
+    read(static_cast<serialization::flat_dict const&>(copy).root(), r3);
+    assert(r3.first_field_with_a_long_name == 7);
+
+    // dict keys are interned once per process: writing allocates the nodes, not their names
+    serialization::dict d2;
+    before = instrumentation::allocation_count();
+    write(d2, r);
+    assert(instrumentation::allocation_count() - before == 2);
+    assert(d2.children.begin()->first.data() == d.children.begin()->first.data());
+}
+
+void test_dict_json()
+{
+    serialization::dict d;
+    custom_record cr;
+    cr.dvalue = 0.1;
+    cr.ivalue = -7;
+    cr.small.letter = '"';
+    cr.small.flag = true;
+    write(d, cr);
+
+    std::string text = serialization::to_json(d);
+    serialization::dict parsed;
+    assert(serialization::from_json(text, parsed));
+    assert(serialization::to_json(parsed) == text);
+
+    custom_record cr2;
+    read(parsed, cr2);
+    assert(cr2.dvalue == 0.1);
+    assert(cr2.ivalue == -7);
+    assert(cr2.small.letter == '"');
+    assert(cr2.small.flag);
+
+    // hand-written config: bare scalars, escapes, a field the struct doesn't know
+    const char* config = "{ \"ivalue\": 42, \"dvalue\": -1.5e3, \"unknown\": null,\n"
+                         "  \"small\": { \"flag\": false, \"letter\": \"\\u0041\" } }";
+    serialization::flat_dict flat;
+    assert(serialization::from_json(config, strlen(config), flat.root()));
+    read(static_cast<serialization::flat_dict const&>(flat).root(), cr2);
+    assert(cr2.ivalue == 42);
+    assert(cr2.dvalue == -1500);
+    assert(cr2.small.letter == 'A');
+    assert(!cr2.small.flag);
+
+    // written back through the node protocol, it reads into a dict like the original
+    std::string flat_text = serialization::to_json(flat.root());
+    serialization::dict from_flat;
+    assert(serialization::from_json(flat_text, from_flat));
+    assert(from_flat.children.size() == 4 && from_flat.children["small"].children["letter"].value == "A");
+    assert(serialization::to_json(static_cast<serialization::flat_dict const&>(flat).root()) == flat_text);
+
+    serialization::dict_arena arena;
+    serialization::arena_dict& arena_root = arena.create();
+    assert(serialization::from_json(config, strlen(config), arena_root));
+    assert(serialization::to_json(arena_root).find("\"unknown\": \"\"") != std::string::npos);
+
+    serialization::dict unicode;
+    assert(serialization::from_json("\"tab\\t \\u00e9 \\ud83d\\ude00\"", unicode));
+    assert(unicode.value == "tab\t \xc3\xa9 \xf0\x9f\x98\x80");
+    assert(serialization::from_json(serialization::to_json(unicode), parsed = serialization::dict()));
+    assert(parsed.value == unicode.value);
+
+    for (const char* bad : { "", "{", "{\"a\" 1}", "{\"a\": 1,}", "{\"a\": [1]}", "\"open", "\"\\ud83d\"", "{} x" })
+    {
+        serialization::dict ignored;
+        assert(!serialization::from_json(bad, strlen(bad), ignored));
+    }
+}
+
+void test_stream_serialization()
+{
+    test_stream_pod();
+    test_stream_not_pod();
+    test_stream_containers();
+    test_stream_compact();
+    test_stream_truncated();
+    test_stream_sink();
+    test_stream_mapped_file();
+    test_stream_compiled_schema();
+    test_stream_not_default_constructible();
+    test_stream_columns();
+    test_stream_parallel();
+    test_stream_framed();
+    test_stream_view();
+    test_stream_compressed();
+    test_stream_checksummed();
+    test_stream_pooled();
+    test_stream_tagged();
+    test_stream_delta();
+}
+
 void test_dict_serialization()
 {
     test_dict_arithmetic();
+    test_dict_scalars();
     test_dict_struct();
     test_dict_versioning();
+    test_flat_dict();
+    test_arena_dict();
+    test_dict_field_names();
+    test_dict_json();
 }
 
 //// Part 3 - common reflect function.
@@ -239,5 +1627,6 @@ int main()
 {
     test_stream_serialization();
     test_dict_serialization();
+
     return 0;
 }
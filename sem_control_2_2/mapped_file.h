@@ -0,0 +1,80 @@
+#pragma once 
+#include <system_error>
+#include <cerrno>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace serialization
+{
+	// read-only memory mapping of a whole file, lets input_stream read straight from the page cache
+	struct mapped_file
+	{
+		explicit mapped_file(const char* path)
+			: data_(nullptr)
+			, size_(0)
+		{
+			int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+				throw std::system_error(errno, std::generic_category(), path);
+
+			struct stat st;
+			if (::fstat(fd, &st) < 0)
+			{
+				int error = errno;
+				::close(fd);
+				throw std::system_error(error, std::generic_category(), path);
+			}
+
+			size_ = static_cast<size_t>(st.st_size);
+			if (size_ != 0)
+			{
+				void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (p == MAP_FAILED)
+				{
+					int error = errno;
+					::close(fd);
+					throw std::system_error(error, std::generic_category(), path);
+				}
+				::madvise(p, size_, MADV_SEQUENTIAL);
+				data_ = static_cast<const char*>(p);
+			}
+			::close(fd);
+		}
+
+		mapped_file(mapped_file&& other) noexcept
+			: data_(other.data_)
+			, size_(other.size_)
+		{
+			other.data_ = nullptr;
+			other.size_ = 0;
+		}
+
+		mapped_file(mapped_file const&) = delete;
+		mapped_file& operator=(mapped_file const&) = delete;
+
+		~mapped_file()
+		{
+			if (data_)
+				::munmap(const_cast<char*>(data_), size_);
+		}
+
+		const char* data() const
+		{
+			return data_;
+		}
+
+		size_t size() const
+		{
+			return size_;
+		}
+
+	private:
+		const char*	data_;
+		size_t		size_;
+	};
+
+} // serialization
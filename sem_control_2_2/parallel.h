@@ -0,0 +1,199 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <system_error>
+
+#include "task.h"
+
+namespace serialization
+{
+
+// Parallel batches: records are split into shards encoded concurrently, each into its own
+// stream, then stitched together behind an offset index so decoding can fan out too.
+//
+//  size_type   shard count
+//  per shard:  size_type record count, size_type size in bytes
+//  shard data, in the same order; each shard is its records written one after another
+
+namespace details
+{
+
+// joins the threads on every way out of the scope, a joinable std::thread terminates when destroyed
+struct thread_joiner
+{
+    std::vector<std::thread>& threads;
+
+    ~thread_joiner()
+    {
+        for (std::thread& thread : threads)
+            if (thread.joinable())
+                thread.join();
+    }
+};
+
+// runs f(0) ... f(tasks - 1) on up to `threads` threads, the calling one included.
+// If f throws, the remaining tasks are abandoned and the first exception is rethrown
+// here once every thread has finished.
+template <class F>
+void parallel_for(size_t tasks, size_t threads, F const& f)
+{
+    threads = std::max<size_t>(1, std::min(threads, tasks));
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::atomic<bool> failed(false);
+    auto run = [&](size_t first)
+    {
+        try
+        {
+            for (size_t task = first; task < tasks && !failed.load(std::memory_order_relaxed); task += threads)
+                f(task);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            failed = true;
+        }
+    };
+
+    {
+        std::vector<std::thread> workers;
+        thread_joiner joiner{ workers };
+        workers.reserve(threads - 1);
+        for (size_t worker = 1; worker < threads; ++worker)
+            workers.emplace_back(run, worker);
+
+        run(0);
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+inline size_t shard_begin(size_t records, size_t shards, size_t shard)
+{
+    return records * shard / shards;
+}
+
+} // details
+
+template <class E, class T>
+void write_parallel(basic_output_stream<E>& os, const std::vector<T>& records, size_t threads)
+{
+    size_t shards = std::max<size_t>(1, std::min(threads, records.size()));
+
+    std::vector<bytes_t> encoded(shards);
+    details::parallel_for(shards, threads, [&](size_t shard)
+    {
+        size_t begin = details::shard_begin(records.size(), shards, shard);
+        size_t end   = details::shard_begin(records.size(), shards, shard + 1);
+
+        basic_output_stream<E> shard_os;
+        shard_os.reserve((end - begin) * serialized_size<T, E>());
+        for (size_t record = begin; record < end; ++record)
+            write(shard_os, records[record]);
+        encoded[shard] = shard_os.detach();
+    });
+
+    write(os, static_cast<size_type>(shards));
+    for (size_t shard = 0; shard < shards; ++shard)
+    {
+        size_t begin = details::shard_begin(records.size(), shards, shard);
+        size_t end   = details::shard_begin(records.size(), shards, shard + 1);
+        write(os, static_cast<size_type>(end - begin));
+        write(os, static_cast<size_type>(encoded[shard].size()));
+    }
+
+    for (bytes_t const& shard : encoded)
+        os.write(shard.data(), shard.size());
+}
+
+namespace details
+{
+
+// false if the batch is truncated or malformed, records are unspecified then
+template <class E, class T>
+bool read_parallel_checked(basic_input_stream<E>& is, std::vector<T>& records, size_t threads)
+{
+    // every shard takes a few bytes of the index, every record at least a byte of the data
+    size_type shards;
+    if (!read_checked(is, shards) || shards > is.remaining())
+        return false;
+
+    const size_type max_size = std::numeric_limits<size_type>::max();
+
+    std::vector<size_type> first_record(shards + 1, 0);
+    std::vector<size_type> offsets(shards + 1, 0);
+    for (size_t shard = 0; shard < shards; ++shard)
+    {
+        size_type count, size;
+        if (!read_checked(is, count) || !read_checked(is, size))
+            return false;
+        if (count > max_size - first_record[shard] || size > max_size - offsets[shard])
+            return false;
+        first_record[shard + 1] = first_record[shard] + count;
+        offsets[shard + 1] = offsets[shard] + size;
+    }
+    if (offsets[shards] > is.remaining() || first_record[shards] > offsets[shards])
+        return false;
+
+    const byte_t* data = is.position();
+    records.resize(first_record[shards]);
+
+    std::atomic<bool> ok(true);
+    parallel_for(shards, threads, [&](size_t shard)
+    {
+        basic_input_stream<E> shard_is(data + offsets[shard], offsets[shard + 1] - offsets[shard]);
+        for (size_t record = first_record[shard]; record < first_record[shard + 1]; ++record)
+        {
+            if (!read_checked(shard_is, records[record]))
+            {
+                ok = false;
+                return;
+            }
+        }
+        if (shard_is.remaining() != 0)
+            ok = false;
+    });
+    if (!ok)
+        return false;
+
+    is.skip(offsets[shards]);
+    return true;
+}
+
+} // details
+
+// throws std::system_error if the batch is truncated or malformed
+template <class E, class T>
+void read_parallel(basic_input_stream<E>& is, std::vector<T>& records, size_t threads)
+{
+    std::error_code ec;
+    read_parallel(is, records, threads, ec);
+    if (ec)
+        throw std::system_error(ec, "read_parallel");
+}
+
+// ec is set if the batch is truncated or malformed, records are unspecified then
+template <class E, class T>
+void read_parallel(basic_input_stream<E>& is, std::vector<T>& records, size_t threads, std::error_code& ec)
+{
+    if (!details::read_parallel_checked(is, records, threads))
+    {
+        ec = stream_errc::truncated;
+        return;
+    }
+
+    if (ec)
+        ec.clear();
+}
+
+} // serialization
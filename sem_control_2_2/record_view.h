@@ -0,0 +1,279 @@
+#pragma once
+
+#include <vector>
+#include <cassert>
+
+#include "task.h"
+
+namespace serialization
+{
+
+// Lazy access to a record encoded with write(): get() decodes one field in place, without
+// reading the rest of the record.
+//
+// The field layout comes from reflect(), once per type: fields up to the first variable-size
+// one (sequences, varints) sit at fixed offsets and are reached directly. Fields after it are
+// found by skipping over the preceding ones, the view remembers how far it got so walking
+// forward field by field doesn't start over.
+
+namespace details
+{
+
+// a default constructed object, for reflect() to walk when only the types of the fields matter
+template <class T>
+T& sample_object()
+{
+    static_assert(std::is_default_constructible<T>::value, "a view has no object of the record type to walk, the type needs a default constructor");
+    static T sample = T();
+    return sample;
+}
+
+template <class E, class T>
+typename std::enable_if<is_raw<E, T>::value, void>::type skip_value(basic_input_stream<E>& is);
+template <class E, class T>
+typename std::enable_if<is_varint<E, T>::value, void>::type skip_value(basic_input_stream<E>& is);
+template <class E, class T>
+typename std::enable_if<is_sequence<T>::value, void>::type skip_value(basic_input_stream<E>& is);
+template <class E, class T>
+typename std::enable_if<is_std_array<T>::value && !is_plain<T>::value, void>::type skip_value(basic_input_stream<E>& is);
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, void>::type skip_value(basic_input_stream<E>& is);
+
+template <class E, class T>
+typename std::enable_if<is_raw<E, T>::value, void>::type
+skip_value(basic_input_stream<E>& is)
+{
+    is.skip(sizeof(T));
+}
+
+template <class E, class T>
+typename std::enable_if<is_varint<E, T>::value, void>::type
+skip_value(basic_input_stream<E>& is)
+{
+    uint64_t value;
+    const byte_t* next = decode_varint(is.position(), is.position() + is.remaining(), value);
+    assert(next);
+    is.skip(next - is.position());
+}
+
+template <class E, class T>
+void skip_elements(basic_input_stream<E>& is, size_t size, bulk_elements)
+{
+    is.skip(size * sizeof(T));
+}
+
+template <class E, class T>
+void skip_elements(basic_input_stream<E>& is, size_t size, swapped_elements)
+{
+    is.skip(size * sizeof(T));
+}
+
+template <class E, class T>
+void skip_elements(basic_input_stream<E>& is, size_t size, varint_elements)
+{
+    for (size_t i = 0; i < size; ++i)
+        skip_value<E, T>(is);
+}
+
+template <class E, class T>
+void skip_elements(basic_input_stream<E>& is, size_t size, each_element)
+{
+    for (size_t i = 0; i < size; ++i)
+        skip_value<E, T>(is);
+}
+
+template <class E, class T>
+typename std::enable_if<is_sequence<T>::value, void>::type
+skip_value(basic_input_stream<E>& is)
+{
+    typedef typename T::value_type value_t;
+
+    size_type size;
+    read(is, size);
+    skip_elements<E, value_t>(is, size, elements_encoding<E, value_t>());
+}
+
+template <class E, class T>
+typename std::enable_if<is_std_array<T>::value && !is_plain<T>::value, void>::type
+skip_value(basic_input_stream<E>& is)
+{
+    if (size_t size = serialized_size<T, E>())
+        return is.skip(size);
+
+    for (size_t i = 0; i < std::tuple_size<T>::value; ++i)
+        skip_value<E, typename T::value_type>(is);
+}
+
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, void>::type
+skip_value(basic_input_stream<E>& is)
+{
+    if (size_t size = serialized_size<T, E>())
+        return is.skip(size);
+
+    reflect([&is](auto& field, field_name)
+    {
+        skip_value<E, typename std::decay<decltype(field)>::type>(is);
+    }, sample_object<T>());
+}
+
+template <class E>
+struct view_field
+{
+    size_t  member_offset;  // offset of the member in the object
+    size_t  encoded_offset; // offset in the encoding, valid up to the first variable-size field
+    void    (*skip)(basic_input_stream<E>&);
+};
+
+// first_variable while the layout is built, until a variable-size field shows up
+const size_t no_variable_field = static_cast<size_t>(-1);
+
+template <class E>
+struct view_layout
+{
+    std::vector<view_field<E>>  fields;
+    size_t                      first_variable; // fields.size() if every field has a fixed size
+    size_t                      fixed_size;     // encoded size of the record, 0 if it varies
+};
+
+template <class T, class E>
+view_layout<E> const& record_layout()
+{
+    static const view_layout<E> layout = []
+    {
+        T& sample = sample_object<T>();
+        const char* object = reinterpret_cast<const char*>(&sample);
+
+        view_layout<E> layout;
+        layout.first_variable = no_variable_field;
+        size_t offset = 0;
+        reflect([&](auto& field, field_name)
+        {
+            typedef typename std::decay<decltype(field)>::type field_t;
+
+            size_t member_offset = reinterpret_cast<const char*>(&field) - object;
+            layout.fields.push_back(view_field<E>{ member_offset, offset, &skip_value<E, field_t> });
+
+            size_t size = serialized_size<field_t, E>();
+            if (size == 0 && layout.first_variable == no_variable_field)
+                layout.first_variable = layout.fields.size() - 1;
+            offset += size;
+        }, sample);
+
+        bool fixed = layout.first_variable == no_variable_field;
+        if (fixed)
+            layout.first_variable = layout.fields.size();
+        layout.fixed_size = fixed ? offset : 0;
+        return layout;
+    }();
+    return layout;
+}
+
+} // details
+
+template <class T, class E>
+class basic_record_view
+{
+public:
+    // borrows the bytes, they must outlive the view
+    basic_record_view(const byte_t* data, size_t size)
+        : data_(data)
+        , size_(size)
+        , resolved_field_(0)
+        , resolved_offset_(0)
+    {
+    }
+
+    // the record at the current position of the stream, which isn't advanced
+    explicit basic_record_view(basic_input_stream<E> const& is)
+        : basic_record_view(is.position(), is.remaining())
+    {
+    }
+
+    // decodes one field: view.get(&custom_record::ivalue)
+    template <class F>
+    F get(F T::* member) const
+    {
+        F value;
+        basic_input_stream<E> is = field_stream(member);
+        read(is, value);
+        return value;
+    }
+
+    // view over a reflected field, to reach into nested records
+    template <class F>
+    basic_record_view<F, E> field_view(F T::* member) const
+    {
+        return basic_record_view<F, E>(field_stream(member));
+    }
+
+    // encoded size of the whole record
+    size_t size() const
+    {
+        details::view_layout<E> const& layout = details::record_layout<T, E>();
+        return layout.fixed_size != 0 ? layout.fixed_size : offset(layout.fields.size());
+    }
+
+private:
+    template <class F>
+    basic_input_stream<E> field_stream(F T::* member) const
+    {
+        size_t field_offset = offset(field_index(member));
+        assert(field_offset <= size_);
+        return basic_input_stream<E>(data_ + field_offset, size_ - field_offset);
+    }
+
+    template <class F>
+    static size_t field_index(F T::* member)
+    {
+        T const& sample = details::sample_object<T>();
+        size_t member_offset = reinterpret_cast<const char*>(&(sample.*member)) - reinterpret_cast<const char*>(&sample);
+
+        auto const& fields = details::record_layout<T, E>().fields;
+        for (size_t index = 0; index < fields.size(); ++index)
+            if (fields[index].member_offset == member_offset)
+                return index;
+
+        assert(!"the member isn't visited by reflect()");
+        return 0;
+    }
+
+    // encoded offset of field `index`, fields.size() for the end of the record
+    size_t offset(size_t index) const
+    {
+        details::view_layout<E> const& layout = details::record_layout<T, E>();
+        if (index <= layout.first_variable)
+        {
+            return index < layout.fields.size() ? layout.fields[index].encoded_offset : layout.fixed_size;
+        }
+
+        if (resolved_field_ < layout.first_variable || resolved_field_ > index)
+        {
+            resolved_field_ = layout.first_variable;
+            resolved_offset_ = layout.fields[layout.first_variable].encoded_offset;
+        }
+
+        basic_input_stream<E> is(data_ + resolved_offset_, size_ - resolved_offset_);
+        for (; resolved_field_ < index; ++resolved_field_)
+            layout.fields[resolved_field_].skip(is);
+
+        resolved_offset_ = is.position() - data_;
+        return resolved_offset_;
+    }
+
+private:
+    const byte_t*   data_;
+    size_t          size_;
+
+    // the furthest field past first_variable whose offset is known
+    mutable size_t  resolved_field_;
+    mutable size_t  resolved_offset_;
+};
+
+template <class T>
+using record_view = basic_record_view<T, fixed_width_encoding>;
+
+template <class T>
+using compact_record_view = basic_record_view<T, compact_encoding>;
+
+} // serialization
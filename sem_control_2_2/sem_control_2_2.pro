@@ -6,15 +6,37 @@ CONFIG -= qt
 QMAKE_CXX = clang++
 QMAKE_CC = clang
 
-CONFIG += c++14
+CONFIG += c++17
+CONFIG += thread
 
-SOURCES += main.cpp
+SOURCES += main.cpp \
+    alloc_count.cpp
 
 include(deployment.pri)
 qtcAddDeployment()
 
 HEADERS += \
+    alloc_count.h \
+    arena_dict.h \
+    buffer_pool.h \
+    byte_order.h \
+    checksummed_blocks.h \
+    columns.h \
+    compressed_blocks.h \
+    crc32c.h \
+    delta.h \
     dict.h \
+    dict_json.h \
+    fd_sink.h \
+    field_name.h \
+    flat_dict.h \
+    framed.h \
     io_streams.h \
-    task.h
+    lz.h \
+    mapped_file.h \
+    parallel.h \
+    record_view.h \
+    tagged.h \
+    task.h \
+    varint.h
 
@@ -0,0 +1,517 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "task.h"
+
+namespace serialization
+{
+
+// Tagged binary records, tolerant to added and removed fields:
+//
+//  record:     varint body size, body
+//  body:       per field: uint32_t field id, varint payload size, payload
+//
+// The field id is the hash of the name reflect() gives the field (field_name::hash()). The
+// payload is the field as write() encodes it, except that reflected records (also as sequence or
+// array elements) are tagged records themselves, so nested types can evolve too. Readers skip
+// fields with ids they don't know and give their own fields missing from the data their default
+// value (fields of types without a default constructor keep theirs).
+//
+// Ids and sizes use the same layout whatever the stream encoding; payloads follow it.
+// Reading is checked: read_tagged() returns false on truncated or malformed data rather than
+// reading past a size. Two fields of a type with the same id are a logic_error when the
+// type is first used.
+
+template <class E, class T>
+void write_tagged(basic_output_stream<E>& os, const T& data);
+template <class E, class T>
+bool read_tagged(basic_input_stream<E>& is, T& data);
+
+namespace details
+{
+
+// containers of reflected records, their elements are tagged records
+template <class T>
+struct is_tagged_sequence : std::false_type {};
+
+template <class T, class A>
+struct is_tagged_sequence<std::vector<T, A>> : is_reflected<T> {};
+
+template <class T, size_t N>
+struct is_tagged_sequence<std::array<T, N>> : is_reflected<T> {};
+
+// field payloads
+
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, void>::type write_tagged_value(basic_output_stream<E>& os, const T& data);
+template <class E, class T>
+typename std::enable_if<is_tagged_sequence<T>::value, void>::type write_tagged_value(basic_output_stream<E>& os, const T& data);
+template <class E, class T>
+typename std::enable_if<!is_reflected<T>::value && !is_tagged_sequence<T>::value, void>::type
+write_tagged_value(basic_output_stream<E>& os, const T& data);
+
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, bool>::type read_tagged_value(basic_input_stream<E>& is, T& data);
+template <class E, class T, class A>
+typename std::enable_if<is_reflected<T>::value, bool>::type read_tagged_value(basic_input_stream<E>& is, std::vector<T, A>& data);
+template <class E, class T, size_t N>
+typename std::enable_if<is_reflected<T>::value, bool>::type read_tagged_value(basic_input_stream<E>& is, std::array<T, N>& data);
+template <class E, class T>
+typename std::enable_if<!is_reflected<T>::value && !is_tagged_sequence<T>::value, bool>::type
+read_tagged_value(basic_input_stream<E>& is, T& data);
+
+template <class E, class T>
+void write_tagged_body(basic_output_stream<E>& os, const T& data);
+template <class E, class T>
+bool read_tagged_body(basic_input_stream<E>& is, T& data);
+
+// reflected fields are written as their body, the field's payload size delimits it
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, void>::type
+write_tagged_value(basic_output_stream<E>& os, const T& data)
+{
+    write_tagged_body(os, data);
+}
+
+template <class E, class T>
+typename std::enable_if<is_tagged_sequence<T>::value, void>::type
+write_tagged_value(basic_output_stream<E>& os, const T& data)
+{
+    if (is_sequence<T>::value)
+        write(os, static_cast<size_type>(data.size()));
+    for (auto const& element : data)
+        write_tagged(os, element);
+}
+
+template <class E, class T>
+typename std::enable_if<!is_reflected<T>::value && !is_tagged_sequence<T>::value, void>::type
+write_tagged_value(basic_output_stream<E>& os, const T& data)
+{
+    write(os, data);
+}
+
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, bool>::type
+read_tagged_value(basic_input_stream<E>& is, T& data)
+{
+    return read_tagged_body(is, data);
+}
+
+template <class E, class T, class A>
+typename std::enable_if<is_reflected<T>::value, bool>::type
+read_tagged_value(basic_input_stream<E>& is, std::vector<T, A>& data)
+{
+    // every element takes at least its body size byte
+    size_type size;
+    if (!read_checked(is, size) || size > is.remaining())
+        return false;
+
+    data.resize(size);
+    for (T& element : data)
+        if (!read_tagged(is, element))
+            return false;
+    return true;
+}
+
+template <class E, class T, size_t N>
+typename std::enable_if<is_reflected<T>::value, bool>::type
+read_tagged_value(basic_input_stream<E>& is, std::array<T, N>& data)
+{
+    for (T& element : data)
+        if (!read_tagged(is, element))
+            return false;
+    return true;
+}
+
+template <class E, class T>
+typename std::enable_if<!is_reflected<T>::value && !is_tagged_sequence<T>::value, bool>::type
+read_tagged_value(basic_input_stream<E>& is, T& data)
+{
+    return read_checked(is, data);
+}
+
+// field layout, built once per type
+
+template <class E>
+struct tagged_field
+{
+    uint32_t    id;
+    size_t      member_offset;
+    size_t      payload_size;   // 0 if it depends on the value
+    bool        (*read)(basic_input_stream<E>&, void* field);
+    void        (*reset)(void* field);
+};
+
+template <class E>
+struct tagged_layout
+{
+    std::vector<tagged_field<E>>            fields;     // in reflect() order
+    std::vector<std::pair<uint32_t, size_t>> by_id;     // (id, index into fields), sorted
+    size_t                                  body_size;  // 0 if it depends on the values
+
+    // index of the field, fields.size() if the type has no such field
+    size_t find(uint32_t id) const
+    {
+        auto it = std::lower_bound(by_id.begin(), by_id.end(), std::make_pair(id, size_t(0)));
+        return it != by_id.end() && it->first == id ? it->second : fields.size();
+    }
+};
+
+template <class E, class F>
+bool read_tagged_field(basic_input_stream<E>& is, void* field)
+{
+    return read_tagged_value(is, *static_cast<F*>(field));
+}
+
+template <class F>
+void reset_tagged_field(void* field, std::true_type)
+{
+    *static_cast<F*>(field) = F();
+}
+
+// a field without a default value keeps the one it has
+template <class F>
+void reset_tagged_field(void*, std::false_type)
+{
+}
+
+template <class F>
+void reset_tagged_field(void* field)
+{
+    reset_tagged_field<F>(field, std::is_default_constructible<F>());
+}
+
+template <class T, class E>
+tagged_layout<E> const& tagged_record_layout(const T& object);
+
+template <class F, class E>
+size_t tagged_record_body_size(std::true_type)
+{
+    return tagged_record_layout<F, E>(F()).body_size;
+}
+
+// without a default constructor there is no object to walk, the payload is sized when written
+template <class F, class E>
+size_t tagged_record_body_size(std::false_type)
+{
+    return 0;
+}
+
+// payload size of a field known from its type alone: raw values and records made of them
+template <class F, class E>
+typename std::enable_if<is_reflected<F>::value, size_t>::type tagged_payload_size()
+{
+    return tagged_record_body_size<F, E>(std::is_default_constructible<F>());
+}
+
+template <class F, class E>
+typename std::enable_if<!is_reflected<F>::value, size_t>::type tagged_payload_size()
+{
+    return is_raw<E, F>::value ? sizeof(F) : 0;
+}
+
+const size_t max_field_header_size = sizeof(uint32_t) + max_varint_size;
+
+inline size_t encode_field_header(byte_t* out, uint32_t id, size_t payload_size)
+{
+    uint32_t wire_id = to_wire_order(id);
+    memcpy(out, &wire_id, sizeof(wire_id));
+    return sizeof(wire_id) + encode_varint(payload_size, out + sizeof(wire_id));
+}
+
+// built from the first object of the type seen, member offsets are the same in all of them
+template <class T, class E>
+tagged_layout<E> const& tagged_record_layout(const T& sample)
+{
+    static const tagged_layout<E> layout = [&sample]
+    {
+        const char* object = reinterpret_cast<const char*>(&sample);
+
+        tagged_layout<E> layout;
+        layout.body_size = 0;
+        bool fixed = true;
+        std::vector<std::string> names;
+        reflect([&](auto& field, field_name name)
+        {
+            names.push_back(name.str());
+            typedef typename std::decay<decltype(field)>::type field_t;
+
+            size_t payload_size = tagged_payload_size<field_t, E>();
+            layout.fields.push_back(tagged_field<E>{ name.hash(), size_t(reinterpret_cast<const char*>(&field) - object),
+                                                     payload_size, &read_tagged_field<E, field_t>, &reset_tagged_field<field_t> });
+
+            byte_t header[max_field_header_size];
+            layout.body_size += encode_field_header(header, 0, payload_size) + payload_size;
+            fixed = fixed && payload_size != 0;
+        }, const_cast<T&>(sample));
+
+        if (!fixed)
+            layout.body_size = 0;
+
+        for (size_t index = 0; index < layout.fields.size(); ++index)
+            layout.by_id.push_back(std::make_pair(layout.fields[index].id, index));
+        std::sort(layout.by_id.begin(), layout.by_id.end());
+        for (size_t index = 1; index < layout.by_id.size(); ++index)
+        {
+            if (layout.by_id[index - 1].first == layout.by_id[index].first)
+                throw std::logic_error("tagged fields '" + names[layout.by_id[index - 1].second] + "' and '"
+                                       + names[layout.by_id[index].second] + "' have the same id, rename one");
+        }
+
+        return layout;
+    }();
+    return layout;
+}
+
+// Payloads whose size isn't known up front are encoded into a scratch stream first.
+// One per nesting level and thread, reused across records.
+template <class E>
+class scratch_stream
+{
+public:
+    scratch_stream()
+    {
+        if (streams().size() == depth())
+            streams().emplace_back(new basic_output_stream<E>());
+        stream_ = streams()[depth()++].get();
+        stream_->clear();
+    }
+
+    ~scratch_stream()
+    {
+        --depth();
+    }
+
+    basic_output_stream<E>& stream()
+    {
+        return *stream_;
+    }
+
+private:
+    static std::vector<std::unique_ptr<basic_output_stream<E>>>& streams()
+    {
+        thread_local std::vector<std::unique_ptr<basic_output_stream<E>>> streams;
+        return streams;
+    }
+
+    static size_t& depth()
+    {
+        thread_local size_t depth = 0;
+        return depth;
+    }
+
+    basic_output_stream<E>* stream_;
+};
+
+template <class E, class F>
+typename std::enable_if<is_varint<E, F>::value, void>::type
+write_tagged_field(basic_output_stream<E>& os, tagged_field<E> const&, uint32_t id, const F& field)
+{
+    byte_t buffer[max_field_header_size + max_varint_size];
+    size_t header_size = sizeof(uint32_t) + 1; // a varint payload is at most 10 bytes, its size fits one byte
+    size_t payload_size = encode_varint(to_varint(field), buffer + header_size);
+    encode_field_header(buffer, id, payload_size);
+    os.write(buffer, header_size + payload_size);
+}
+
+template <class E, class F>
+typename std::enable_if<!is_varint<E, F>::value, void>::type
+write_tagged_field(basic_output_stream<E>& os, tagged_field<E> const& layout, uint32_t id, const F& field)
+{
+    byte_t header[max_field_header_size];
+    if (layout.payload_size != 0)
+    {
+        os.write(header, encode_field_header(header, id, layout.payload_size));
+        write_tagged_value(os, field);
+        return;
+    }
+
+    scratch_stream<E> scratch;
+    write_tagged_value(scratch.stream(), field);
+    bytes_t const& payload = scratch.stream().data();
+    os.write(header, encode_field_header(header, id, payload.size()));
+    os.write(payload.data(), payload.size());
+}
+
+template <class E, class T>
+void write_tagged_body(basic_output_stream<E>& os, const T& data)
+{
+    tagged_layout<E> const& layout = tagged_record_layout<T, E>(data);
+    tagged_field<E> const* field_layout = layout.fields.data();
+
+    os.reserve_extra(layout.body_size);
+    reflect([&os, &field_layout](auto& field, field_name)
+    {
+        write_tagged_field(os, *field_layout, field_layout->id, field);
+        ++field_layout;
+    }, const_cast<T&>(data));
+}
+
+// fields seen while reading a body, a bit per field
+class field_set
+{
+public:
+    explicit field_set(size_t fields)
+        : small_(0)
+    {
+        if (fields > 64)
+            large_.resize(fields);
+    }
+
+    void insert(size_t field)
+    {
+        if (large_.empty())
+            small_ |= uint64_t(1) << field;
+        else
+            large_[field] = true;
+    }
+
+    bool contains(size_t field) const
+    {
+        return large_.empty() ? (small_ >> field & 1) != 0 : large_[field];
+    }
+
+private:
+    uint64_t            small_;
+    std::vector<bool>   large_;
+};
+
+// false if the header is truncated or the payload runs past the end of the body
+template <class E>
+bool read_field_header(basic_input_stream<E>& is, uint32_t& id, size_t& payload_size)
+{
+    if (is.remaining() < sizeof(id))
+        return false;
+    is.read(&id, sizeof(id));
+    id = to_wire_order(id);
+
+    uint64_t size;
+    const byte_t* next = decode_varint(is.position(), is.position() + is.remaining(), size);
+    if (!next)
+        return false;
+    is.skip(next - is.position());
+    if (size > is.remaining())
+        return false;
+
+    payload_size = static_cast<size_t>(size);
+    return true;
+}
+
+template <class E, class T>
+bool read_tagged_body(basic_input_stream<E>& is, T& data)
+{
+    tagged_layout<E> const& layout = tagged_record_layout<T, E>(data);
+    char* object = reinterpret_cast<char*>(&data);
+    field_set seen(layout.fields.size());
+
+    // data written by the same version of the type has its fields in reflect() order,
+    // they are read inline until the first one that isn't where it is expected
+    size_t index = 0;
+    bool in_order = true;
+    bool ok = true;
+    reflect([&](auto& field, field_name)
+    {
+        if (!in_order || is.remaining() < sizeof(uint32_t))
+        {
+            in_order = false;
+            return;
+        }
+
+        uint32_t id;
+        memcpy(&id, is.position(), sizeof(id));
+        if (to_wire_order(id) != layout.fields[index].id)
+        {
+            in_order = false;
+            return;
+        }
+
+        size_t payload_size;
+        if (!read_field_header(is, id, payload_size))
+        {
+            in_order = ok = false;
+            return;
+        }
+        basic_input_stream<E> payload(is.position(), payload_size);
+        if (!read_tagged_value(payload, field))
+        {
+            in_order = ok = false;
+            return;
+        }
+        is.skip(payload_size);
+        seen.insert(index++);
+    }, data);
+
+    if (!ok)
+        return false;
+
+    while (is.remaining() != 0)
+    {
+        uint32_t id;
+        size_t payload_size;
+        if (!read_field_header(is, id, payload_size))
+            return false;
+
+        size_t field = layout.find(id);
+        if (field != layout.fields.size())
+        {
+            basic_input_stream<E> payload(is.position(), payload_size);
+            if (!layout.fields[field].read(payload, object + layout.fields[field].member_offset))
+                return false;
+            seen.insert(field);
+        }
+        is.skip(payload_size);
+    }
+
+    if (index == layout.fields.size())
+        return true;
+
+    for (size_t field = 0; field < layout.fields.size(); ++field)
+        if (!seen.contains(field))
+            layout.fields[field].reset(object + layout.fields[field].member_offset);
+    return true;
+}
+
+} // details
+
+template <class E, class T>
+void write_tagged(basic_output_stream<E>& os, const T& data)
+{
+    byte_t prefix[max_varint_size];
+    if (size_t body_size = details::tagged_record_layout<T, E>(data).body_size)
+    {
+        os.write(prefix, encode_varint(body_size, prefix));
+        details::write_tagged_body(os, data);
+        return;
+    }
+
+    details::scratch_stream<E> scratch;
+    details::write_tagged_body(scratch.stream(), data);
+    bytes_t const& body = scratch.stream().data();
+    os.write(prefix, encode_varint(body.size(), prefix));
+    os.write(body.data(), body.size());
+}
+
+// false if the record is truncated or malformed, data is unspecified then
+template <class E, class T>
+bool read_tagged(basic_input_stream<E>& is, T& data)
+{
+    uint64_t body_size;
+    const byte_t* next = decode_varint(is.position(), is.position() + is.remaining(), body_size);
+    if (!next || body_size > static_cast<size_t>(is.position() + is.remaining() - next))
+        return false;
+    is.skip(next - is.position());
+
+    basic_input_stream<E> body(is.position(), static_cast<size_t>(body_size));
+    if (!details::read_tagged_body(body, data))
+        return false;
+    is.skip(static_cast<size_t>(body_size));
+    return true;
+}
+
+} // serialization
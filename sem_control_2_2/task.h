@@ -1,9 +1,15 @@
 #pragma once
 
 #include <type_traits>
-#include <sstream>
+#include <charconv>
+#include <string>
+#include <vector>
+#include <array>
 
+#include "byte_order.h"
+#include "field_name.h"
 #include "io_streams.h"
+#include "varint.h"
 #include "dict.h"
 
 
@@ -12,76 +18,911 @@ namespace serialization
 
 // task1 -----------------
 
+// Binary encoding:
+//  - scalars and PODs without reflect() are written as raw bytes, scalars in little endian order,
+//  - on compact streams multi-byte integers are written as varints instead,
+//  - std::vector and std::basic_string as a size_type length prefix followed by the elements,
+//    a single memcpy when the elements are trivially copyable,
+//  - std::array as its elements, without a prefix,
+//  - everything else field by field through reflect(). This includes PODs that provide reflect(),
+//    so their padding never reaches the stream and the output only depends on the field values.
+
+template <class T>
+struct is_sequence : std::false_type {};
+
+template <class T, class A>
+struct is_sequence<std::vector<T, A>> : std::true_type {};
+
+template <class C, class Tr, class A>
+struct is_sequence<std::basic_string<C, Tr, A>> : std::true_type {};
+
 template <class T>
-typename std::enable_if<std::is_pod<T>::value, void>::type
-read(input_stream& is, T& data)
+struct is_std_array : std::false_type {};
+
+template <class T, size_t N>
+struct is_std_array<std::array<T, N>> : std::true_type {};
+
+namespace details
 {
-    is.read(&data, sizeof(T));
+
+struct any_field_visitor
+{
+    template <class F>
+    void operator()(F& field, field_name name) const;
+};
+
+template <class T, class = void>
+struct has_reflect : std::false_type {};
+
+template <class T>
+struct has_reflect<T, decltype(reflect(std::declval<const any_field_visitor&>(), std::declval<T&>()))>
+    : std::true_type
+{
+};
+
+} // details
+
+// PODs copied byte for byte: scalars, and structs (or arrays of them) that don't provide reflect()
+template <class T>
+struct is_plain
+    : std::integral_constant<bool, std::is_pod<T>::value && !details::has_reflect<T>::value>
+{
+};
+
+template <class T, size_t N>
+struct is_plain<std::array<T, N>> : is_plain<T> {};
+
+template <class T, size_t N>
+struct is_plain<T[N]> : is_plain<T> {};
+
+// types (de)serialized through reflect()
+template <class T>
+struct is_reflected
+    : std::integral_constant<bool, !is_plain<T>::value && !is_sequence<T>::value && !is_std_array<T>::value>
+{
+};
+
+// integers written as varints by streams with the given encoding
+template <class encoding_t, class T>
+struct is_varint
+    : std::integral_constant<bool, std::is_same<encoding_t, compact_encoding>::value
+                                   && std::is_integral<T>::value && (sizeof(T) > 1)>
+{
+};
+
+// values written as their raw bytes
+template <class encoding_t, class T>
+struct is_raw
+    : std::integral_constant<bool, is_plain<T>::value && !is_varint<encoding_t, T>::value>
+{
+};
+
+// elements that can be copied as one block: the ones written raw anyway, unless they need a
+// byte swap. Reflected elements aren't, even when trivially copyable, so they are encoded
+// the same way in and out of containers.
+template <class encoding_t, class T>
+struct is_bulk_copyable
+    : std::integral_constant<bool, is_raw<encoding_t, T>::value && !std::is_same<T, bool>::value
+                                   && !needs_byte_swap<T>::value>
+{
+};
+
+// all overloads are declared up front, so reflected fields and container elements can refer to each other
+
+template <class T, class E = fixed_width_encoding>
+typename std::enable_if<is_raw<E, T>::value, size_t>::type serialized_size();
+template <class T, class E = fixed_width_encoding>
+typename std::enable_if<is_varint<E, T>::value || is_sequence<T>::value, size_t>::type serialized_size();
+template <class T, class E = fixed_width_encoding>
+typename std::enable_if<is_std_array<T>::value && !is_plain<T>::value, size_t>::type serialized_size();
+template <class T, class E = fixed_width_encoding>
+typename std::enable_if<is_reflected<T>::value, size_t>::type serialized_size();
+
+template <class T>
+typename std::enable_if<is_plain<T>::value, size_t>::type measure(const T& data);
+template <class T>
+typename std::enable_if<is_sequence<T>::value, size_t>::type measure(const T& data);
+template <class T, size_t N>
+typename std::enable_if<!is_plain<T>::value, size_t>::type measure(const std::array<T, N>& data);
+template <class T>
+typename std::enable_if<is_reflected<T>::value, size_t>::type measure(const T& data);
+
+template <class E, class T>
+typename std::enable_if<is_raw<E, T>::value, void>::type read(basic_input_stream<E>& is, T& data);
+template <class E, class T>
+typename std::enable_if<is_varint<E, T>::value, void>::type read(basic_input_stream<E>& is, T& data);
+template <class E, class T>
+typename std::enable_if<is_sequence<T>::value, void>::type read(basic_input_stream<E>& is, T& data);
+template <class E, class A>
+void read(basic_input_stream<E>& is, std::vector<bool, A>& data);
+template <class E, class T, size_t N>
+typename std::enable_if<!is_plain<T>::value, void>::type read(basic_input_stream<E>& is, std::array<T, N>& data);
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, void>::type read(basic_input_stream<E>& is, T& data);
+
+template <class E, class T>
+typename std::enable_if<is_raw<E, T>::value, void>::type write(basic_output_stream<E>& os, const T& data);
+template <class E, class T>
+typename std::enable_if<is_varint<E, T>::value, void>::type write(basic_output_stream<E>& os, const T& data);
+template <class E, class T>
+typename std::enable_if<is_sequence<T>::value, void>::type write(basic_output_stream<E>& os, const T& data);
+template <class E, class A>
+void write(basic_output_stream<E>& os, const std::vector<bool, A>& data);
+template <class E, class T, size_t N>
+typename std::enable_if<!is_plain<T>::value, void>::type write(basic_output_stream<E>& os, const std::array<T, N>& data);
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, void>::type write(basic_output_stream<E>& os, const T& data);
+
+// serialized_size: encoded size of types made only of fixed-size fields, 0 for anything else.
+// Reflected types are walked once per type, the result is cached. The walk needs a default
+// constructed object; types without a default constructor report 0 and are measured per value.
+
+namespace details
+{
+
+template <class T, class E>
+size_t reflected_serialized_size(std::false_type)
+{
+    return 0;
+}
+
+template <class T, class E>
+size_t reflected_serialized_size(std::true_type)
+{
+    T sample = T();
+    size_t size = 0;
+    bool fixed = true;
+    reflect([&size, &fixed](auto& field, field_name)
+    {
+        size_t field_size = serialized_size<typename std::decay<decltype(field)>::type, E>();
+        fixed = fixed && field_size != 0;
+        size += field_size;
+    }, sample);
+    return fixed ? size : 0;
+}
+
+} // details
+
+template <class T, class E>
+typename std::enable_if<is_raw<E, T>::value, size_t>::type
+serialized_size()
+{
+    return sizeof(T);
+}
+
+template <class T, class E>
+typename std::enable_if<is_varint<E, T>::value || is_sequence<T>::value, size_t>::type
+serialized_size()
+{
+    return 0;
+}
+
+template <class T, class E>
+typename std::enable_if<is_std_array<T>::value && !is_plain<T>::value, size_t>::type
+serialized_size()
+{
+    return std::tuple_size<T>::value * serialized_size<typename T::value_type, E>();
 }
 
+template <class T, class E>
+typename std::enable_if<is_reflected<T>::value, size_t>::type
+serialized_size()
+{
+    static const size_t size = details::reflected_serialized_size<T, E>(std::is_default_constructible<T>());
+    return size;
+}
+
+// measure: number of bytes write(output_stream&, data) is going to emit.
+// Compact streams use it as an estimate.
+
 template <class T>
-typename std::enable_if<std::is_pod<T>::value, void>::type
-write(output_stream& is, const T& data)
+typename std::enable_if<is_plain<T>::value, size_t>::type
+measure(const T&)
 {
-    is.write(&data, sizeof(T));
+    return sizeof(T);
 }
 
 template <class T>
-typename std::enable_if<!(std::is_pod<T>::value), void>::type
-read(input_stream& is, T& data)
+typename std::enable_if<is_sequence<T>::value, size_t>::type
+measure(const T& data)
+{
+    typedef typename T::value_type value_t;
+
+    size_t size = sizeof(size_type);
+    if (is_bulk_copyable<fixed_width_encoding, value_t>::value)
+        return size + data.size() * sizeof(value_t);
+
+    if (size_t element_size = serialized_size<value_t>())
+        return size + data.size() * element_size;
+
+    for (const value_t& element : data)
+        size += measure(element);
+    return size;
+}
+
+template <class T, size_t N>
+typename std::enable_if<!is_plain<T>::value, size_t>::type
+measure(const std::array<T, N>& data)
 {
-    reflect([&is](auto& field, const std::string& name){read(is, field);}, data);
+    if (size_t size = serialized_size<std::array<T, N>>())
+        return size;
+
+    size_t size = 0;
+    for (const T& element : data)
+        size += measure(element);
+    return size;
 }
 
 template <class T>
-typename std::enable_if<!(std::is_pod<T>::value), void>::type
-write(output_stream& os, const T& data)
+typename std::enable_if<is_reflected<T>::value, size_t>::type
+measure(const T& data)
+{
+    if (size_t size = serialized_size<T>())
+        return size;
+
+    size_t size = 0;
+    reflect([&size](auto& field, field_name){ size += measure(field); }, const_cast<T&>(data));
+    return size;
+}
+
+// Schema compilation: a reflected type whose fields are all copied as is is flattened into
+// a list of (offset, size) runs, adjacent fields merged into one run. Such types are then
+// written and read with one memcpy per run instead of walking reflect() per field.
+// reflect() can't run at compile time, so the schema is compiled once per type on first use.
+
+namespace details
+{
+
+struct field_run
+{
+    size_t offset;
+    size_t size;
+};
+
+struct schema_builder
+{
+    schema_builder(const void* object, size_t object_size)
+        : object_(static_cast<const char*>(object))
+        , object_size_(object_size)
+        , compiled_(true)
+    {
+    }
+
+    void add(const void* field, size_t size)
+    {
+        const char* p = static_cast<const char*>(field);
+
+        // a field living outside the object (reflect() may expose anything) can't be described by an offset
+        if (p < object_ || p + size > object_ + object_size_)
+        {
+            compiled_ = false;
+            return;
+        }
+
+        size_t offset = p - object_;
+        if (!runs_.empty() && runs_.back().offset + runs_.back().size == offset)
+            runs_.back().size += size;
+        else
+            runs_.push_back(field_run{ offset, size });
+    }
+
+    void fail()
+    {
+        compiled_ = false;
+    }
+
+    bool compiled() const
+    {
+        return compiled_;
+    }
+
+    std::vector<field_run> const& runs() const
+    {
+        return runs_;
+    }
+
+private:
+    const char*             object_;
+    size_t                  object_size_;
+    bool                    compiled_;
+    std::vector<field_run>  runs_;
+};
+
+template <class E, class F>
+typename std::enable_if<is_raw<E, F>::value, void>::type compile_field(schema_builder& builder, F& field);
+template <class E, class F, size_t N>
+typename std::enable_if<!is_plain<F>::value, void>::type compile_field(schema_builder& builder, std::array<F, N>& field);
+template <class E, class F>
+typename std::enable_if<is_reflected<F>::value, void>::type compile_field(schema_builder& builder, F& field);
+template <class E, class F>
+typename std::enable_if<!is_raw<E, F>::value && !is_reflected<F>::value && !is_std_array<F>::value, void>::type
+compile_field(schema_builder& builder, F& field);
+
+template <class E, class F>
+typename std::enable_if<is_raw<E, F>::value, void>::type
+compile_field(schema_builder& builder, F& field)
+{
+    // a plain memcpy would keep the host byte order
+    if (needs_byte_swap<F>::value)
+        builder.fail();
+    else
+        builder.add(&field, sizeof(F));
+}
+
+template <class E, class F, size_t N>
+typename std::enable_if<!is_plain<F>::value, void>::type
+compile_field(schema_builder& builder, std::array<F, N>& field)
+{
+    for (F& element : field)
+        compile_field<E>(builder, element);
+}
+
+template <class E, class F>
+typename std::enable_if<is_reflected<F>::value, void>::type
+compile_field(schema_builder& builder, F& field)
+{
+    reflect([&builder](auto& field, field_name){ compile_field<E>(builder, field); }, field);
+}
+
+// varints and sequences
+template <class E, class F>
+typename std::enable_if<!is_raw<E, F>::value && !is_reflected<F>::value && !is_std_array<F>::value, void>::type
+compile_field(schema_builder& builder, F&)
+{
+    builder.fail();
+}
+
+template <class T, class E>
+std::pair<bool, std::vector<field_run>> compile_schema(std::false_type)
+{
+    return std::make_pair(false, std::vector<field_run>());
+}
+
+template <class T, class E>
+std::pair<bool, std::vector<field_run>> compile_schema(std::true_type)
+{
+    T sample = T();
+    schema_builder builder(&sample, sizeof(T));
+    compile_field<E>(builder, sample);
+    return std::make_pair(builder.compiled(), builder.runs());
+}
+
+// runs of a reflected type, nullptr if it has fields that aren't written raw or no default
+// constructor to compile the schema from (such types are walked with reflect())
+template <class T, class E>
+std::vector<field_run> const* compiled_schema()
+{
+    static const std::pair<bool, std::vector<field_run>> schema
+        = compile_schema<T, E>(std::is_default_constructible<T>());
+    return schema.first ? &schema.second : nullptr;
+}
+
+} // details
+
+template <class E, class T>
+typename std::enable_if<is_raw<E, T>::value, void>::type
+read(basic_input_stream<E>& is, T& data)
+{
+    is.read(&data, sizeof(T));
+    if (needs_byte_swap<T>::value)
+        data = to_wire_order(data);
+}
+
+template <class E, class T>
+typename std::enable_if<is_raw<E, T>::value, void>::type
+write(basic_output_stream<E>& is, const T& data)
+{
+    if (needs_byte_swap<T>::value)
+    {
+        T swapped = to_wire_order(data);
+        is.write(&swapped, sizeof(T));
+    }
+    else
+        is.write(&data, sizeof(T));
+}
+
+template <class E, class T>
+typename std::enable_if<is_varint<E, T>::value, void>::type
+read(basic_input_stream<E>& is, T& data)
+{
+    uint64_t value;
+    const byte_t* next = decode_varint(is.position(), is.position() + is.remaining(), value);
+    assert(next);
+    is.skip(next - is.position());
+    data = from_varint<T>(value);
+}
+
+template <class E, class T>
+typename std::enable_if<is_varint<E, T>::value, void>::type
+write(basic_output_stream<E>& os, const T& data)
+{
+    byte_t buffer[max_varint_size];
+    os.write(buffer, encode_varint(to_varint(data), buffer));
+}
+
+namespace details
+{
+
+// how the elements of a sequence are encoded
+struct bulk_elements {};
+struct swapped_elements {};
+struct varint_elements {};
+struct each_element {};
+
+template <class E, class T>
+using elements_encoding = typename std::conditional<is_bulk_copyable<E, T>::value, bulk_elements,
+                          typename std::conditional<is_raw<E, T>::value && needs_byte_swap<T>::value, swapped_elements,
+                          typename std::conditional<is_varint<E, T>::value, varint_elements,
+                                                    each_element>::type>::type>::type;
+
+// elements converted to wire byte order a batch at a time
+const size_t swap_batch = 256;
+
+template <class E, class T>
+void write_elements(basic_output_stream<E>& os, const T* data, size_t size, bulk_elements)
+{
+    os.write(data, size * sizeof(T));
+}
+
+// varints are batched through a local buffer
+template <class E, class T>
+void write_elements(basic_output_stream<E>& os, const T* data, size_t size, varint_elements)
+{
+    const size_t batch = 64;
+    byte_t buffer[batch * max_varint_size];
+
+    while (size != 0)
+    {
+        size_t count = size < batch ? size : batch;
+        size_t encoded = 0;
+        for (size_t i = 0; i < count; ++i)
+            encoded += encode_varint(to_varint(data[i]), buffer + encoded);
+
+        os.write(buffer, encoded);
+        data += count;
+        size -= count;
+    }
+}
+
+template <class E, class T>
+void write_elements(basic_output_stream<E>& os, const T* data, size_t size, swapped_elements)
+{
+    T buffer[swap_batch];
+    while (size != 0)
+    {
+        size_t count = size < swap_batch ? size : swap_batch;
+        to_wire_order(data, buffer, count);
+        os.write(buffer, count * sizeof(T));
+        data += count;
+        size -= count;
+    }
+}
+
+template <class E, class T>
+void write_elements(basic_output_stream<E>& os, const T* data, size_t size, each_element)
 {
-    reflect([&os](auto& field, const std::string& name){write(os, field);}, const_cast<T&>(data));
+    for (size_t i = 0; i < size; ++i)
+        write(os, data[i]);
+}
+
+template <class E, class T>
+void read_elements(basic_input_stream<E>& is, T* data, size_t size, bulk_elements)
+{
+    is.read(data, size * sizeof(T));
+}
+
+template <class E, class T>
+void read_elements(basic_input_stream<E>& is, T* data, size_t size, swapped_elements)
+{
+    is.read(data, size * sizeof(T));
+    to_wire_order(data, data, size);
+}
+
+template <class E, class T>
+void read_elements(basic_input_stream<E>& is, T* data, size_t size, varint_elements)
+{
+    const byte_t* next = decode_varints(is.position(), is.position() + is.remaining(), data, size);
+    assert(next);
+    is.skip(next - is.position());
+}
+
+template <class E, class T>
+void read_elements(basic_input_stream<E>& is, T* data, size_t size, each_element)
+{
+    for (size_t i = 0; i < size; ++i)
+        read(is, data[i]);
+}
+
+} // details
+
+template <class E, class T>
+typename std::enable_if<is_sequence<T>::value, void>::type
+read(basic_input_stream<E>& is, T& data)
+{
+    typedef typename T::value_type value_t;
+
+    size_type size;
+    read(is, size);
+    data.resize(size);
+
+    if (size != 0)
+        details::read_elements(is, &data[0], size, details::elements_encoding<E, value_t>());
+}
+
+template <class E, class T>
+typename std::enable_if<is_sequence<T>::value, void>::type
+write(basic_output_stream<E>& os, const T& data)
+{
+    typedef typename T::value_type value_t;
+
+    os.reserve_extra(measure(data));
+    write(os, static_cast<size_type>(data.size()));
+
+    if (!data.empty())
+        details::write_elements(os, data.data(), data.size(), details::elements_encoding<E, value_t>());
+}
+
+// std::vector<bool> packs its bits and has no data(), its elements are written one by one
+template <class E, class A>
+void read(basic_input_stream<E>& is, std::vector<bool, A>& data)
+{
+    size_type size;
+    read(is, size);
+    data.resize(size);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        bool value;
+        read(is, value);
+        data[i] = value;
+    }
+}
+
+template <class E, class A>
+void write(basic_output_stream<E>& os, const std::vector<bool, A>& data)
+{
+    os.reserve_extra(measure(data));
+    write(os, static_cast<size_type>(data.size()));
+
+    for (bool value : data)
+        write(os, value);
+}
+
+template <class E, class T, size_t N>
+typename std::enable_if<!is_plain<T>::value, void>::type
+read(basic_input_stream<E>& is, std::array<T, N>& data)
+{
+    for (T& element : data)
+        read(is, element);
+}
+
+template <class E, class T, size_t N>
+typename std::enable_if<!is_plain<T>::value, void>::type
+write(basic_output_stream<E>& os, const std::array<T, N>& data)
+{
+    os.reserve_extra(measure(data));
+    for (const T& element : data)
+        write(os, element);
+}
+
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, void>::type
+read(basic_input_stream<E>& is, T& data)
+{
+    if (auto runs = details::compiled_schema<T, E>())
+    {
+        char* object = reinterpret_cast<char*>(&data);
+        for (details::field_run const& run : *runs)
+            is.read(object + run.offset, run.size);
+        return;
+    }
+
+    reflect([&is](auto& field, field_name name){read(is, field);}, data);
+}
+
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, void>::type
+write(basic_output_stream<E>& os, const T& data)
+{
+    if (auto runs = details::compiled_schema<T, E>())
+    {
+        const char* object = reinterpret_cast<const char*>(&data);
+        os.reserve_extra(serialized_size<T, E>());
+        for (details::field_run const& run : *runs)
+            os.write(object + run.offset, run.size);
+        return;
+    }
+
+    os.reserve_extra(measure(data));
+    reflect([&os](auto& field, field_name name){write(os, field);}, const_cast<T&>(data));
+}
+
+// checked read for untrusted input. Fixed-size values are validated once up front,
+// so reading their fields has no extra branches; variable-size ones are checked per
+// length prefix and varint. On failure the stream position is unspecified.
+
+namespace details
+{
+
+template <class E, class T>
+typename std::enable_if<!is_varint<E, T>::value, bool>::type read_checked(basic_input_stream<E>& is, T& data);
+
+template <class E, class T>
+typename std::enable_if<is_varint<E, T>::value, bool>::type read_checked(basic_input_stream<E>& is, T& data);
+
+template <class E, class T, class A>
+bool read_checked(basic_input_stream<E>& is, std::vector<T, A>& data);
+
+template <class E, class A>
+bool read_checked(basic_input_stream<E>& is, std::vector<bool, A>& data);
+
+template <class E, class C, class Tr, class A>
+bool read_checked(basic_input_stream<E>& is, std::basic_string<C, Tr, A>& data);
+
+template <class E, class T, size_t N>
+bool read_checked(basic_input_stream<E>& is, std::array<T, N>& data);
+
+template <class E, class T>
+typename std::enable_if<is_reflected<T>::value, bool>::type
+read_fields_checked(basic_input_stream<E>& is, T& data)
+{
+    bool ok = true;
+    reflect([&is, &ok](auto& field, field_name){ ok = ok && read_checked(is, field); }, data);
+    return ok;
+}
+
+template <class E, class T>
+typename std::enable_if<!is_reflected<T>::value, bool>::type
+read_fields_checked(basic_input_stream<E>&, T&)
+{
+    return false;
+}
+
+template <class E, class T>
+typename std::enable_if<!is_varint<E, T>::value, bool>::type
+read_checked(basic_input_stream<E>& is, T& data)
+{
+    if (size_t size = serialized_size<T, E>())
+    {
+        if (is.remaining() < size)
+            return false;
+
+        read(is, data);
+        return true;
+    }
+    return read_fields_checked(is, data);
+}
+
+template <class E, class T>
+typename std::enable_if<is_varint<E, T>::value, bool>::type
+read_checked(basic_input_stream<E>& is, T& data)
+{
+    uint64_t value;
+    const byte_t* next = decode_varint(is.position(), is.position() + is.remaining(), value);
+    if (!next)
+        return false;
+
+    is.skip(next - is.position());
+    data = from_varint<T>(value);
+    return true;
+}
+
+template <class E, class T>
+bool read_elements_checked(basic_input_stream<E>& is, T* data, size_t size, bulk_elements)
+{
+    read_elements(is, data, size, bulk_elements());
+    return true;
+}
+
+template <class E, class T>
+bool read_elements_checked(basic_input_stream<E>& is, T* data, size_t size, swapped_elements)
+{
+    read_elements(is, data, size, swapped_elements());
+    return true;
+}
+
+template <class E, class T>
+bool read_elements_checked(basic_input_stream<E>& is, T* data, size_t size, varint_elements)
+{
+    const byte_t* next = decode_varints(is.position(), is.position() + is.remaining(), data, size);
+    if (!next)
+        return false;
+
+    is.skip(next - is.position());
+    return true;
+}
+
+template <class E, class T>
+bool read_elements_checked(basic_input_stream<E>& is, T* data, size_t size, each_element)
+{
+    for (size_t i = 0; i < size; ++i)
+        if (!read_checked(is, data[i]))
+            return false;
+    return true;
+}
+
+template <class E, class sequence_t>
+bool read_sequence_checked(basic_input_stream<E>& is, sequence_t& data)
+{
+    typedef typename sequence_t::value_type value_t;
+
+    size_type size;
+    if (!read_checked(is, size))
+        return false;
+
+    // every element takes at least a byte, don't let a corrupted prefix allocate unbounded memory
+    size_t element_size = is_raw<E, value_t>::value && !std::is_same<value_t, bool>::value ? sizeof(value_t) : 1;
+    if (size > is.remaining() / element_size)
+        return false;
+
+    data.resize(size);
+    return size == 0 || read_elements_checked(is, &data[0], size, elements_encoding<E, value_t>());
+}
+
+template <class E, class T, class A>
+bool read_checked(basic_input_stream<E>& is, std::vector<T, A>& data)
+{
+    return read_sequence_checked(is, data);
+}
+
+template <class E, class A>
+bool read_checked(basic_input_stream<E>& is, std::vector<bool, A>& data)
+{
+    size_type size;
+    if (!read_checked(is, size) || size > is.remaining())
+        return false;
+
+    data.resize(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        bool value;
+        if (!read_checked(is, value))
+            return false;
+        data[i] = value;
+    }
+    return true;
+}
+
+template <class E, class C, class Tr, class A>
+bool read_checked(basic_input_stream<E>& is, std::basic_string<C, Tr, A>& data)
+{
+    return read_sequence_checked(is, data);
+}
+
+template <class E, class T, size_t N>
+bool read_checked(basic_input_stream<E>& is, std::array<T, N>& data)
+{
+    if (serialized_size<std::array<T, N>, E>())
+        return read_checked<E, std::array<T, N>>(is, data);
+
+    for (T& element : data)
+        if (!read_checked(is, element))
+            return false;
+    return true;
+}
+
+} // details
+
+template <class E, class T>
+void read(basic_input_stream<E>& is, T& data, std::error_code& ec)
+{
+    if (!details::read_checked(is, data))
+    {
+        ec = stream_errc::truncated;
+        return;
+    }
+
+    if (ec)
+        ec.clear(); // clear() isn't inline, don't pay for it on every record
 }
 
 //task2 -----------------
 
+// Works with any dict node type, see the dict node protocol in dict.h
+
+// Scalars are converted with to_chars/from_chars: locale independent, no allocations,
+// doubles round-trip exactly. Character types are stored as the character itself, bool as 0/1.
+
+namespace details
+{
+
+template <class T>
+struct is_character
+    : std::integral_constant<bool, std::is_same<T, char>::value || std::is_same<T, signed char>::value
+                                   || std::is_same<T, unsigned char>::value>
+{
+};
+
+template <class T>
+typename std::enable_if<is_character<T>::value, bool>::type
+from_chars(const char* first, const char* last, T& data)
+{
+    if (first == last)
+        return false;
+
+    data = static_cast<T>(*first);
+    return true;
+}
+
+inline bool from_chars(const char* first, const char* last, bool& data)
+{
+    unsigned value;
+    if (std::from_chars(first, last, value).ec != std::errc())
+        return false;
+
+    data = value != 0;
+    return true;
+}
+
 template <class T>
-typename std::enable_if<std::is_arithmetic<T>::value, void>::type
-read(const dict& d, T& data)
+typename std::enable_if<!is_character<T>::value && !std::is_same<T, bool>::value, bool>::type
+from_chars(const char* first, const char* last, T& data)
 {
-    std::stringstream stream;
-    stream << d.value;
-    stream >> data;
+    return std::from_chars(first, last, data).ec == std::errc();
 }
 
+// returns the end of the written characters
 template <class T>
-typename std::enable_if<std::is_arithmetic<T>::value, void>::type
-write(dict& d, const T& data)
+typename std::enable_if<is_character<T>::value, char*>::type
+to_chars(char* first, char*, T data)
 {
-    std::stringstream stream;
-    stream << data;
-    stream >> d.value;
+    *first = static_cast<char>(data);
+    return first + 1;
+}
+
+inline char* to_chars(char* first, char*, bool data)
+{
+    *first = data ? '1' : '0';
+    return first + 1;
 }
 
 template <class T>
-typename std::enable_if<!std::is_arithmetic<T>::value, void>::type
-read(const dict& d, T& data)
+typename std::enable_if<!is_character<T>::value && !std::is_same<T, bool>::value, char*>::type
+to_chars(char* first, char* last, T data)
+{
+    return std::to_chars(first, last, data).ptr;
+}
+
+} // details
+
+template <class D, class T>
+typename std::enable_if<is_dict_node<D>::value && std::is_arithmetic<T>::value, void>::type
+read(const D& d, T& data)
+{
+    auto const& value = dict_value(d);
+    if (!details::from_chars(value.data(), value.data() + value.size(), data))
+        data = T();
+}
+
+template <class D, class T>
+typename std::enable_if<is_dict_node<typename std::decay<D>::type>::value && std::is_arithmetic<T>::value, void>::type
+write(D&& d, const T& data)
 {
-    reflect([&d](auto& field, const std::string& name)
+    char buffer[64]; // enough for the shortest round-trip form of any arithmetic type
+    char* end = details::to_chars(buffer, buffer + sizeof(buffer), data);
+    set_dict_value(d, buffer, end - buffer);
+}
+
+template <class D, class T>
+typename std::enable_if<is_dict_node<D>::value && !std::is_arithmetic<T>::value, void>::type
+read(const D& d, T& data)
+{
+    reflect([&d](auto& field, field_name name)
     {
-        try
-        {
-            read(d.children.at(name), field);
-        }
-        catch(const std::out_of_range& e)
-        {
+        // fields missing in the dict (added in a newer version of the struct) get their default value
+        if (auto child = find_child(d, name))
+            read(*child, field);
+        else
             field = typename std::remove_reference<decltype(field)>::type();
-        }
     }, data);
 }
 
-template <class T>
-typename std::enable_if<!std::is_arithmetic<T>::value, void>::type
-write(dict& d, const T& data)
+template <class D, class T>
+typename std::enable_if<is_dict_node<typename std::decay<D>::type>::value && !std::is_arithmetic<T>::value, void>::type
+write(D&& d, const T& data)
 {
-    reflect([&d](auto& field, const std::string& name){ write(d.children[name], field); }, const_cast<T&>(data));
+    reflect([&d](auto& field, field_name name){ write(add_child(d, name), field); }, const_cast<T&>(data));
+    close_children(d);
 }
 
 } // serialization
@@ -0,0 +1,115 @@
+#pragma once 
+#include <type_traits>
+#include <stdint.h>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace serialization
+{
+	// LEB128 varints: 7 bits per byte, least significant group first, high bit set on all but the last byte
+	const size_t max_varint_size = 10;
+
+	// signed values are zigzag mapped (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...) so small magnitudes stay short
+	template<class T>
+	typename std::enable_if<std::is_signed<T>::value, uint64_t>::type
+	to_varint(T value)
+	{
+		int64_t v = value;
+		return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+	}
+
+	template<class T>
+	typename std::enable_if<std::is_unsigned<T>::value, uint64_t>::type
+	to_varint(T value)
+	{
+		return value;
+	}
+
+	template<class T>
+	typename std::enable_if<std::is_signed<T>::value, T>::type
+	from_varint(uint64_t value)
+	{
+		return static_cast<T>(static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1));
+	}
+
+	template<class T>
+	typename std::enable_if<std::is_unsigned<T>::value, T>::type
+	from_varint(uint64_t value)
+	{
+		return static_cast<T>(value);
+	}
+
+	// writes at most max_varint_size bytes, returns the number written
+	inline size_t encode_varint(uint64_t value, char* out)
+	{
+		size_t size = 0;
+		while (value >= 0x80)
+		{
+			out[size++] = static_cast<char>(value | 0x80);
+			value >>= 7;
+		}
+		out[size++] = static_cast<char>(value);
+		return size;
+	}
+
+	// returns the position past the varint, nullptr if it is truncated or longer than max_varint_size
+	inline const char* decode_varint(const char* p, const char* end, uint64_t& value)
+	{
+		uint64_t result = 0;
+		for (unsigned shift = 0; shift < 7 * max_varint_size && p != end; shift += 7)
+		{
+			uint64_t byte = static_cast<unsigned char>(*p++);
+			result |= (byte & 0x7f) << shift;
+			if (byte < 0x80)
+			{
+				value = result;
+				return p;
+			}
+		}
+		return nullptr;
+	}
+
+	// decodes count varints into out, same result as count calls to decode_varint.
+	// Runs of single-byte varints (small values, the common case) are found 16 bytes at a time with SSE2.
+	template<class T>
+	const char* decode_varints(const char* p, const char* end, T* out, size_t count)
+	{
+#if defined(__SSE2__)
+		while (count >= 16 && end - p >= 16)
+		{
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(chunk));
+			size_t singles = mask == 0 ? 16 : static_cast<size_t>(__builtin_ctz(mask));
+
+			for (size_t i = 0; i < singles; ++i)
+				out[i] = from_varint<T>(static_cast<unsigned char>(p[i]));
+			p += singles;
+			out += singles;
+			count -= singles;
+
+			if (singles != 16)
+			{
+				uint64_t value;
+				p = decode_varint(p, end, value);
+				if (!p)
+					return nullptr;
+				*out++ = from_varint<T>(value);
+				--count;
+			}
+		}
+#endif
+		for (; count != 0; --count)
+		{
+			uint64_t value;
+			p = decode_varint(p, end, value);
+			if (!p)
+				return nullptr;
+			*out++ = from_varint<T>(value);
+		}
+		return p;
+	}
+
+} // serialization